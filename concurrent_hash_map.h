@@ -0,0 +1,312 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#ifndef CONCURRENT_HASH_MAP_H_
+#define CONCURRENT_HASH_MAP_H_
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "hash_map_2.h"
+
+/* This class is thread safe hash table made of SHARD_COUNT independent HashMap shards.
+Every shard has its own reader/writer lock, the shard of a key is chosen by high bits of
+splitmix64-mixed hash, so threads that work with different keys almost never wait for each other
+and readers of the same shard don't block each other at all. Shards are aligned to the cache line,
+so neighbour locks don't share it. Every shard is usual HashMap, so iteration over a shard is
+linear pass over its dense value_store_. A key is hashed once: the shard is chosen by the hash,
+and the same hash is given to the *_hashed methods of the shard.
+
+Methods never return references or iterators into the table, because another thread may move
+the element right after the lock is released. Values are copied out or processed by the given
+function while the lock is held. Such function must not call methods of the same table. */
+template<class KeyType, class ValueType, class Hash = std::hash<KeyType>,
+                            class KeyEqual = std::equal_to<KeyType>,
+                            class Allocator = std::allocator<std::pair<const KeyType, ValueType>>,
+                            class IndexPolicy = ChainedIndex<>,
+                            bool CacheHash = false,
+                            class StoragePolicy = PairStorage,
+                            class StatsPolicy = NoStats>
+class ConcurrentHashMap {
+ public:
+    using Shard = HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator, IndexPolicy, CacheHash,
+                          StoragePolicy, StatsPolicy>;
+
+    /* Creates empty table with at least shard_count shards (rounded up to power of two).
+    Time: O(shard_count). */
+    explicit ConcurrentHashMap(size_t shard_count = DEFAULT_SHARD_COUNT_,
+                               const Hash& hasher = Hash(),
+                               const KeyEqual& key_equal = KeyEqual(),
+                               const Allocator& allocator = Allocator()) :
+                        hasher_(hasher) {
+        for (size_t i = 0, count = reserve_shards(shard_count); i < count; i++) {
+            shards_.push_back(std::make_unique<ShardSlot>(hasher, key_equal, allocator));
+        }
+    }
+
+    /* Creates empty table, memory of shard i is taken from shard_allocator(i). With
+    PageAllocator (page_allocator.h) every shard can live on its own NUMA node:
+        using Allocator = PageAllocator<std::pair<const uint64_t, Session>>;
+        ConcurrentHashMap<uint64_t, Session, WyHash<uint64_t>, std::equal_to<uint64_t>,
+                          Allocator, GroupProbingIndex<>> table(64, [](size_t shard) {
+            return Allocator(HugePages::TRANSPARENT, shard % numa_node_count());
+        });
+    Threads pinned to a node touch only local memory, if they take the keys, whose
+    shard_number is on their node. Time: O(shard_count). */
+    template<class ShardAllocator, class = typename std::enable_if<std::is_convertible<
+                        std::invoke_result_t<ShardAllocator&, size_t>, Allocator>::value>::type>
+    ConcurrentHashMap(size_t shard_count, ShardAllocator shard_allocator,
+                      const Hash& hasher = Hash(), const KeyEqual& key_equal = KeyEqual()) :
+                        hasher_(hasher) {
+        for (size_t i = 0, count = reserve_shards(shard_count); i < count; i++) {
+            shards_.push_back(std::make_unique<ShardSlot>(hasher, key_equal, shard_allocator(i)));
+        }
+    }
+
+    // Time: O(1).
+    size_t shard_count() const {
+        return shards_.size();
+    }
+
+    /* Number of the shard of the key, the same for the whole life of the table, so work on
+    keys can be routed to threads near the memory of their shard. Shard is taken from high bits
+    of the hash after the splitmix64 finalizer. HashMap inside the shard picks buckets from bits
+    of the hash itself (modulo, low bits, high bits of the Fibonacci product), and none of them
+    says anything about the finalizer's high bits, so keys of one shard still spread over all its
+    buckets. Time: O(1). */
+    size_t shard_number(const KeyType& key) const {
+        return hash_shard(hasher_(key));
+    }
+
+    // Allocator of the shard with given number. Time: O(1).
+    Allocator shard_allocator(size_t shard_number) const {
+        return shards_[shard_number]->map.get_allocator();
+    }
+
+    // Sum of sizes of all shards, shards are locked one by one. Time: O(shard_count).
+    size_t size() const {
+        size_t result = 0;
+        for (auto& shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard->mutex);
+            result += shard->map.size();
+        }
+        return result;
+    }
+
+    // Time: O(shard_count).
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /* Sum of stats of all shards, the shards are locked one by one. Counters of lookups are
+    updated under shared locks, so with CountingStats readers count in parallel.
+    Time: O(bucket_count of all shards). */
+    HashMapStats stats() const {
+        HashMapStats result;
+        for (auto& shard : shards_) {
+            std::shared_lock<std::shared_mutex> lock(shard->mutex);
+            result += shard->map.stats();
+        }
+        return result;
+    }
+
+    // Time: expected O(1).
+    bool contains(const KeyType& key) const {
+        size_t hash = hasher_(key);
+        const ShardSlot& shard = shard_of(hash);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.find_hashed(hash, key) != shard.map.end();
+    }
+
+    /* Copies the value of the key into value and returns true if the key is in the table.
+    Time: expected O(1). */
+    bool find(const KeyType& key, ValueType& value) const {
+        size_t hash = hasher_(key);
+        const ShardSlot& shard = shard_of(hash);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto iter = shard.map.find_hashed(hash, key);
+        if (iter == shard.map.end()) {
+            return false;
+        }
+        value = iter->second;
+        return true;
+    }
+
+    /* Calls function(const ValueType&) with the value of the key under shared lock.
+    Returns false if there is no such key. Time: expected O(1). */
+    template<class Function>
+    bool visit(const KeyType& key, Function function) const {
+        size_t hash = hasher_(key);
+        const ShardSlot& shard = shard_of(hash);
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        auto iter = shard.map.find_hashed(hash, key);
+        if (iter == shard.map.end()) {
+            return false;
+        }
+        function(static_cast<const ValueType&>(iter->second));
+        return true;
+    }
+
+    // Inserts element if there was no such key, returns true if it was inserted. Time: expected O(1).
+    bool insert(const std::pair<KeyType, ValueType>& key_value) {
+        size_t hash = hasher_(key_value.first);
+        ShardSlot& shard = shard_of(hash);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.try_emplace_hashed(hash, key_value.first, key_value.second).second;
+    }
+
+    // The same as insert above, but key and value are moved into the table.
+    bool insert(std::pair<KeyType, ValueType>&& key_value) {
+        size_t hash = hasher_(key_value.first);
+        ShardSlot& shard = shard_of(hash);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.try_emplace_hashed(hash, std::move(key_value.first),
+                                            std::move(key_value.second)).second;
+    }
+
+    /* Inserts the value or assigns it to the existing element. Returns true if it was
+    inserted. Time: expected O(1). */
+    template<class M>
+    bool insert_or_assign(const KeyType& key, M&& value) {
+        size_t hash = hasher_(key);
+        ShardSlot& shard = shard_of(hash);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto result = shard.map.try_emplace_hashed(hash, key, std::forward<M>(value));
+        if (!result.second) {
+            result.first->second = std::forward<M>(value);
+        }
+        return result.second;
+    }
+
+    /* Calls function(ValueType&) with the value of the key under exclusive lock, so
+    read-modify-write is atomic. Returns false if there is no such key. Time: expected O(1). */
+    template<class Function>
+    bool update(const KeyType& key, Function function) {
+        size_t hash = hasher_(key);
+        ShardSlot& shard = shard_of(hash);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto iter = shard.map.find_hashed(hash, key);
+        if (iter == shard.map.end()) {
+            return false;
+        }
+        function(iter->second);
+        return true;
+    }
+
+    /* The same as update, but inserts default value first if there is no such key.
+    Returns true if the key was inserted. Time: expected O(1). */
+    template<class Function>
+    bool upsert(const KeyType& key, Function function) {
+        size_t hash = hasher_(key);
+        ShardSlot& shard = shard_of(hash);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        auto result = shard.map.try_emplace_hashed(hash, key);
+        function(result.first->second);
+        return result.second;
+    }
+
+    // Removes the key, returns number of removed elements (0 or 1). Time: expected O(1).
+    size_t erase(const KeyType& key) {
+        size_t hash = hasher_(key);
+        ShardSlot& shard = shard_of(hash);
+        std::unique_lock<std::shared_mutex> lock(shard.mutex);
+        return shard.map.erase_hashed(hash, key);
+    }
+
+    // Clears shards one by one. Time: O(quantity of elements in the table).
+    void clear() {
+        for (auto& shard : shards_) {
+            std::unique_lock<std::shared_mutex> lock(shard->mutex);
+            shard->map.clear();
+        }
+    }
+
+    // Reserves place for count elements spread evenly over shards. Time: O(count).
+    void reserve(size_t count) {
+        for (auto& shard : shards_) {
+            std::unique_lock<std::shared_mutex> lock(shard->mutex);
+            shard->map.reserve(count / shards_.size() + 1);
+        }
+    }
+
+    /* Calls function(const Shard&) for the shard with given number under shared lock,
+    so the shard can be scanned linearly. Time: O(1) + time of the function. */
+    template<class Function>
+    void visit_shard(size_t shard_number, Function function) const {
+        const ShardSlot& shard = *shards_[shard_number];
+        std::shared_lock<std::shared_mutex> lock(shard.mutex);
+        function(shard.map);
+    }
+
+    /* Calls function(element) for every element (ElementReference with members first and
+    second), the shards are locked one by one. Time: O(quantity of elements in the table). */
+    template<class Function>
+    void for_each(Function function) const {
+        for (size_t i = 0; i < shards_.size(); i++) {
+            visit_shard(i, [&](const Shard& map) {
+                for (const auto& element : map) {
+                    function(element);
+                }
+            });
+        }
+    }
+
+ private:
+    /* Shard with its lock, on its own cache lines. Every slot is allocated alone and its map
+    is constructed with its allocator, because a lock can't be moved and allocators that don't
+    propagate (std::pmr) would be lost by assignment of a map. */
+    struct alignas(64) ShardSlot {
+        ShardSlot(const Hash& hasher, const KeyEqual& key_equal, const Allocator& allocator) :
+                        map(hasher, key_equal, allocator) {}
+
+        mutable std::shared_mutex mutex;
+        Shard map;
+    };
+
+    std::vector<std::unique_ptr<ShardSlot>> shards_;
+    size_t shard_bits_ = 0;
+    Hash hasher_;
+    constexpr static size_t DEFAULT_SHARD_COUNT_ = 64;
+
+    /* Rounds shard_count up to power of two, sets shard_bits_ for it and reserves the slots.
+    Returns the rounded count. */
+    size_t reserve_shards(size_t shard_count) {
+        shard_count = PowerOfTwoSizing::round(shard_count);
+        shards_.reserve(shard_count);
+        while ((static_cast<size_t>(1) << shard_bits_) < shard_count) {
+            shard_bits_++;
+        }
+        return shard_count;
+    }
+
+    // Number of the shard of the key with this hash, see shard_number. Time: O(1).
+    size_t hash_shard(size_t hash) const {
+        uint64_t mixed = static_cast<uint64_t>(hash);
+        mixed = (mixed ^ (mixed >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+        mixed = (mixed ^ (mixed >> 27)) * UINT64_C(0x94D049BB133111EB);
+        mixed ^= mixed >> 31;
+        return static_cast<size_t>((mixed >> (63 - shard_bits_)) >> 1);
+    }
+
+    ShardSlot& shard_of(size_t hash) {
+        return *shards_[hash_shard(hash)];
+    }
+
+    const ShardSlot& shard_of(size_t hash) const {
+        return *shards_[hash_shard(hash)];
+    }
+};
+
+// Threading policy of HashMapPolicies: ConcurrentHashMap with locked shards.
+struct ShardedLocking {
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+             class IndexPolicy, bool CacheHash, class StoragePolicy, class StatsPolicy>
+    using map = ConcurrentHashMap<KeyType, ValueType, Hash, KeyEqual, Allocator, IndexPolicy,
+                                  CacheHash, StoragePolicy, StatsPolicy>;
+};
+
+#endif  // CONCURRENT_HASH_MAP_H_
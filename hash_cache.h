@@ -0,0 +1,185 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#ifndef HASH_CACHE_H_
+#define HASH_CACHE_H_
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <utility>
+
+#include "hash_map_2.h"
+
+/* Cache of at most capacity() elements with CLOCK eviction, in one HashMap without a separate
+recency list. Every element of value_store_ keeps a referenced bit next to its value, get sets
+it. When a put of a new key makes the table one element bigger than the capacity, the clock hand
+walks over value_store_ clearing the bits until it finds an element without one, and that one
+is erased: the back element fills its place as in erase, so eviction is O(1) amortized and a hit
+or a miss is one lookup. All memory (capacity + 1 elements and the index for them) is reserved
+by the constructor, and OpenAddressingIndex erases without tombstones, so at steady state the
+cache allocates nothing (keys and values may still allocate themselves, as strings do).
+GroupProbingIndex works too, but it rebuilds its control bytes now and then to drop tombstones.
+Pointers returned by get are valid until the next put or erase. */
+template<class KeyType, class ValueType, class Hash = std::hash<KeyType>,
+                            class KeyEqual = std::equal_to<KeyType>,
+                            class Allocator = std::allocator<std::pair<const KeyType, ValueType>>,
+                            class IndexPolicy = OpenAddressingIndex<>,
+                            bool CacheHash = false,
+                            class StoragePolicy = PairStorage>
+class HashCache {
+    // Value with the referenced bit of CLOCK.
+    struct Entry {
+        template<class... Args>
+        explicit Entry(std::in_place_t, Args&&... args) :
+                        value(std::forward<Args>(args)...), referenced(false) {}
+
+        ValueType value;
+        bool referenced;
+    };
+
+    using EntryAllocator = typename std::allocator_traits<Allocator>::template
+                                    rebind_alloc<std::pair<const KeyType, Entry>>;
+    using Entries = HashMap<KeyType, Entry, Hash, KeyEqual, EntryAllocator, IndexPolicy,
+                            CacheHash, StoragePolicy>;
+
+ public:
+    using allocator_type = Allocator;
+
+    /* Creates empty cache for capacity elements and allocates all its memory. Throws
+    invalid_argument for zero capacity. Time: O(capacity). */
+    explicit HashCache(size_t capacity, const Hash& hasher = Hash(),
+                       const KeyEqual& key_equal = KeyEqual(),
+                       const Allocator& allocator = Allocator()) :
+                        entries_(hasher, key_equal, EntryAllocator(allocator)),
+                        capacity_(capacity),
+                        hand_(0) {
+        if (capacity == 0) {
+            throw std::invalid_argument("HashCache capacity must be positive");
+        }
+        entries_.reserve(capacity + 1);
+    }
+
+    // Time: O(1).
+    size_t size() const {
+        return entries_.size();
+    }
+
+    // Time: O(1).
+    bool empty() const {
+        return entries_.empty();
+    }
+
+    // The most elements the cache keeps. Time: O(1).
+    size_t capacity() const {
+        return capacity_;
+    }
+
+    /* Returns pointer to the value of the key and marks it as referenced, or nullptr if there
+    is no such key. Time: expected O(1). */
+    ValueType* get(const KeyType& key) {
+        auto position = entries_.find(key);
+        if (position == entries_.end()) {
+            return nullptr;
+        }
+        Entry& entry = position->second;
+        entry.referenced = true;
+        return &entry.value;
+    }
+
+    // The same as get, but the key is not marked, so the lookup doesn't delay its eviction.
+    const ValueType* peek(const KeyType& key) const {
+        auto position = entries_.find(key);
+        return (position == entries_.end()) ? nullptr : &position->second.value;
+    }
+
+    // Time: expected O(1).
+    bool contains(const KeyType& key) const {
+        return entries_.contains(key);
+    }
+
+    /* Assigns the value to the key and marks it as referenced, or inserts the key, evicting
+    one element if the cache was full. Returns true if the key was inserted.
+    Time: expected and amortized O(1). */
+    template<class M>
+    bool put(const KeyType& key, M&& value) {
+        return put_key(key, std::forward<M>(value));
+    }
+
+    // The same as put above, but new key is moved into the cache.
+    template<class M>
+    bool put(KeyType&& key, M&& value) {
+        return put_key(std::move(key), std::forward<M>(value));
+    }
+
+    // Removes the key, returns number of removed elements. Time: expected O(1).
+    size_t erase(const KeyType& key) {
+        return entries_.erase(key);
+    }
+
+    /* Calls function(const KeyType&, const ValueType&) for every element in the order of
+    value_store_, the referenced bits are not changed. Time: O(size()). */
+    template<class Function>
+    void for_each(Function function) const {
+        for (const auto& element : entries_) {
+            function(element.first, static_cast<const ValueType&>(element.second.value));
+        }
+    }
+
+    // Removes all elements, the memory stays reserved. Time: O(size()).
+    void clear() {
+        entries_.clear_keep_capacity();
+        hand_ = 0;
+    }
+
+    // Time: O(1).
+    Allocator get_allocator() const {
+        return Allocator(entries_.get_allocator());
+    }
+
+ private:
+    Entries entries_;
+    size_t capacity_;
+    // Position of value_store_, where the clock hand looks for the next victim.
+    size_t hand_;
+
+    /* A new key is inserted first, so a put is one lookup, then the extra element is evicted.
+    The new element is at the back and the hand skips it. Time: expected and amortized O(1). */
+    template<class Key, class M>
+    bool put_key(Key&& key, M&& value) {
+        auto result = entries_.try_emplace(std::forward<Key>(key), std::in_place,
+                                           std::forward<M>(value));
+        if (!result.second) {
+            Entry& entry = result.first->second;
+            entry.value = std::forward<M>(value);
+            entry.referenced = true;
+            return false;
+        }
+        if (entries_.size() > capacity_) {
+            evict(entries_.size() - 1);
+        }
+        return true;
+    }
+
+    /* Clears referenced bits from the hand on until an element without the bit, other than
+    skip, is found, and erases it. The element moved into its place is the new one, so the
+    hand steps over it. Time: amortized O(1), at most two rounds of value_store_. */
+    void evict(size_t skip) {
+        for (;; hand_++) {
+            if (hand_ >= entries_.size()) {
+                hand_ = 0;
+            }
+            if (hand_ == skip) {
+                continue;
+            }
+            Entry& entry = (entries_.begin() + hand_)->second;
+            if (!entry.referenced) {
+                break;
+            }
+            entry.referenced = false;
+        }
+        entries_.erase(entries_.begin() + hand_);
+        hand_++;
+    }
+};
+
+#endif  // HASH_CACHE_H_
@@ -0,0 +1,195 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#ifndef HASH_COUNTER_H_
+#define HASH_COUNTER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "hash_map_2.h"
+
+/* Counts of keys (frequencies, histograms, word counts) in HashMap<KeyType, CountType>.
+add is one lookup: a new key is inserted with count 0 by the same search, that found no key.
+add_all takes keys by batches of BATCH_SIZE_: every key is hashed once, equal keys of the batch
+are summed in a small local table over these hashes (a sort of the batch costs more than it
+saves), and each distinct key of the batch is added once with its precomputed hash while the
+index places of the next keys are prefetched. Skewed streams (a few hot keys) touch the table
+once per batch for every hot key. */
+template<class KeyType, class CountType = int64_t, class Hash = std::hash<KeyType>,
+                            class KeyEqual = std::equal_to<KeyType>,
+                            class Allocator = std::allocator<std::pair<const KeyType, CountType>>,
+                            class IndexPolicy = ChainedIndex<>,
+                            bool CacheHash = false,
+                            class StoragePolicy = PairStorage>
+class HashCounter {
+    using Counts = HashMap<KeyType, CountType, Hash, KeyEqual, Allocator, IndexPolicy, CacheHash,
+                           StoragePolicy>;
+
+ public:
+    using const_iterator = typename Counts::const_iterator;
+
+    // Creates empty counter. Time: O(1).
+    HashCounter(const Hash& hasher = Hash(), const KeyEqual& key_equal = KeyEqual(),
+                const Allocator& allocator = Allocator()) :
+                        counts_(hasher, key_equal, allocator) {}
+
+    // Number of different keys. Time: O(1).
+    size_t size() const {
+        return counts_.size();
+    }
+
+    // Time: O(1).
+    bool empty() const {
+        return counts_.empty();
+    }
+
+    // Adds delta to the count of the key, returns the new count. Time: expected O(1).
+    CountType add(const KeyType& key, CountType delta = 1) {
+        return counts_[key] += delta;
+    }
+
+    // The same as add above, but new key is moved into the table.
+    CountType add(KeyType&& key, CountType delta = 1) {
+        return counts_[std::move(key)] += delta;
+    }
+
+    // Adds 1 for every key of the array, see the class comment. Time: expected O(count).
+    void add_all(const KeyType* keys, size_t count) {
+        add_batches(keys, count, [](size_t) { return CountType(1); });
+    }
+
+    // Adds deltas[i] to the count of keys[i]. Time: expected O(count).
+    void add_all(const KeyType* keys, const CountType* deltas, size_t count) {
+        add_batches(keys, count, [deltas](size_t i) { return deltas[i]; });
+    }
+
+    /* Adds 1 for every key of a contiguous container (std::vector, std::array, std::span).
+    Time: expected O(size of the container). */
+    template<class Keys>
+    void add_all(const Keys& keys) {
+        add_all(std::data(keys), std::size(keys));
+    }
+
+    // Adds 1 for every key of the list. Time: expected O(size of the list).
+    void add_all(std::initializer_list<KeyType> keys) {
+        add_all(keys.begin(), keys.size());
+    }
+
+    // Count of the key, 0 if it was never added. Time: expected O(1).
+    CountType count(const KeyType& key) const {
+        auto position = counts_.find(key);
+        return (position == counts_.end()) ? CountType() : position->second;
+    }
+
+    // Time: expected O(1).
+    bool contains(const KeyType& key) const {
+        return counts_.contains(key);
+    }
+
+    // Removes the key and its count, returns number of removed keys. Time: expected O(1).
+    size_t erase(const KeyType& key) {
+        return counts_.erase(key);
+    }
+
+    /* Returns up to n keys with the largest counts, the largest first.
+    Time: O(size() * log(n)). */
+    std::vector<std::pair<KeyType, CountType>> most_common(size_t n) const {
+        std::vector<std::pair<KeyType, CountType>> result(counts_.begin(), counts_.end());
+        n = std::min(n, result.size());
+        std::partial_sort(result.begin(), result.begin() + n, result.end(),
+                          [](const auto& left, const auto& right) {
+                              return left.second > right.second;
+                          });
+        result.resize(n);
+        return result;
+    }
+
+    // Reserves place for count keys. Time: O(count).
+    void reserve(size_t count) {
+        counts_.reserve(count);
+    }
+
+    // Time: O(quantity of keys).
+    void clear() {
+        counts_.clear();
+    }
+
+    // Pairs of keys and counts. Time: O(1).
+    const_iterator begin() const {
+        return counts_.begin();
+    }
+
+    const_iterator end() const {
+        return counts_.end();
+    }
+
+    // The table of counts. Time: O(1).
+    const Counts& counts() const {
+        return counts_;
+    }
+
+ private:
+    constexpr static size_t BATCH_SIZE_ = 256;
+    // Distance in distinct keys between prefetch of an index place and its insert.
+    constexpr static size_t PREFETCH_DISTANCE_ = 8;
+
+    // Key of a batch with its hash and the sum of its deltas.
+    struct BatchEntry {
+        size_t hash;
+        const KeyType* key;
+        CountType delta;
+    };
+
+    Counts counts_;
+
+    /* Hashes and sums every batch, then adds the sums, see the class comment. Keys with equal
+    hashes, but not equal, are summed separately. Time: expected O(count). */
+    template<class Delta>
+    void add_batches(const KeyType* keys, size_t count, Delta delta) {
+        const Hash hasher = counts_.hash_function();
+        const KeyEqual key_equal = counts_.key_eq();
+        BatchEntry batch[BATCH_SIZE_];
+        for (size_t begin = 0; begin < count; begin += BATCH_SIZE_) {
+            size_t batch_size = std::min(BATCH_SIZE_, count - begin);
+            for (size_t i = 0; i < batch_size; i++) {
+                batch[i] = {hasher(keys[begin + i]), &keys[begin + i], delta(begin + i)};
+            }
+            // Entries are summed in a local open addressing table over the same hashes.
+            uint16_t cells[2 * BATCH_SIZE_] = {};
+            size_t distinct = 0;
+            for (size_t i = 0; i < batch_size; i++) {
+                size_t cell = batch[i].hash & (2 * BATCH_SIZE_ - 1);
+                while (cells[cell] != 0) {
+                    BatchEntry& entry = batch[cells[cell] - 1];
+                    if (entry.hash == batch[i].hash && key_equal(*entry.key, *batch[i].key)) {
+                        entry.delta += batch[i].delta;
+                        break;
+                    }
+                    cell = (cell + 1) & (2 * BATCH_SIZE_ - 1);
+                }
+                if (cells[cell] == 0) {
+                    batch[distinct] = batch[i];
+                    cells[cell] = static_cast<uint16_t>(++distinct);
+                }
+            }
+            for (size_t i = 0; i < std::min(PREFETCH_DISTANCE_, distinct); i++) {
+                counts_.prefetch_hashed(batch[i].hash);
+            }
+            for (size_t i = 0; i < distinct; i++) {
+                if (i + PREFETCH_DISTANCE_ < distinct) {
+                    counts_.prefetch_hashed(batch[i + PREFETCH_DISTANCE_].hash);
+                }
+                counts_.try_emplace_hashed(batch[i].hash, *batch[i].key).first->second +=
+                                batch[i].delta;
+            }
+        }
+    }
+};
+
+#endif  // HASH_COUNTER_H_
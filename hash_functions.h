@@ -0,0 +1,220 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#ifndef HASH_FUNCTIONS_H_
+#define HASH_FUNCTIONS_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+/* Fast hash functions for HashMap. std::hash of integers and pointers is the identity in
+libstdc++, so with PowerOfTwoSizing (or ModuloSizing and keys with a common stride) keys pile
+up in few buckets. WyHash hashes integers with the 64-bit mix of wyhash (two multiplications)
+and strings with wyhash (final version 4), MixedHash adds the same mix after any user hash:
+    HashMap<uint64_t, Session, WyHash<uint64_t>, std::equal_to<uint64_t>, ...>
+    HashMap<Point, int, MixedHash<PointHash>, ...>
+Results are not the same on all platforms: bytes are read in native byte order. */
+
+// Constants of wyhash.
+constexpr uint64_t WYHASH_SECRET[4] = {
+    UINT64_C(0xa0761d6478bd642f), UINT64_C(0xe7037ed1a0b428db),
+    UINT64_C(0x8ebc6af09c88c6e3), UINT64_C(0x589965cc75374cc3)};
+
+/* Full 128-bit product of a and b: a gets its low half, b gets the high one. One mul
+instruction with 128-bit integers, four 32-bit multiplies elsewhere. */
+inline void wyhash_multiply(uint64_t& a, uint64_t& b) {
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 product = static_cast<unsigned __int128>(a) * b;
+    a = static_cast<uint64_t>(product);
+    b = static_cast<uint64_t>(product >> 64);
+#else
+    uint64_t a_high = a >> 32, a_low = static_cast<uint32_t>(a);
+    uint64_t b_high = b >> 32, b_low = static_cast<uint32_t>(b);
+    uint64_t high = a_high * b_high, middle0 = a_high * b_low;
+    uint64_t middle1 = b_high * a_low, low = a_low * b_low;
+    uint64_t sum = low + (middle0 << 32);
+    uint64_t carry = sum < low;
+    a = sum + (middle1 << 32);
+    carry += a < sum;
+    b = high + (middle0 >> 32) + (middle1 >> 32) + carry;
+#endif
+}
+
+// Xor of the halves of the 128-bit product. Time: O(1).
+inline uint64_t wyhash_mix(uint64_t a, uint64_t b) {
+    wyhash_multiply(a, b);
+    return a ^ b;
+}
+
+// Hash of 64-bit number: all bits of the input reach all bits of the result. Time: O(1).
+inline uint64_t wyhash_64(uint64_t value, uint64_t seed = 0) {
+    uint64_t a = value ^ WYHASH_SECRET[0];
+    uint64_t b = seed ^ WYHASH_SECRET[1];
+    wyhash_multiply(a, b);
+    return wyhash_mix(a ^ WYHASH_SECRET[0], b ^ WYHASH_SECRET[1]);
+}
+
+// Seed as wyhash_bytes_mixed takes it, so the mix is done once per hash function. Time: O(1).
+inline uint64_t wyhash_mix_seed(uint64_t seed) {
+    return seed ^ wyhash_mix(seed ^ WYHASH_SECRET[0], WYHASH_SECRET[1]);
+}
+
+/* wyhash of length bytes with the seed from wyhash_mix_seed. Inputs up to 16 bytes take two
+overlapping reads, longer ones are consumed by 48-byte blocks in three independent multiply
+chains, which the processor runs in parallel. Time: O(length). */
+inline uint64_t wyhash_bytes_mixed(const void* data, size_t length, uint64_t seed) {
+    auto read8 = [](const unsigned char* p) {
+        uint64_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return value;
+    };
+    auto read4 = [](const unsigned char* p) {
+        uint32_t value;
+        std::memcpy(&value, p, sizeof(value));
+        return static_cast<uint64_t>(value);
+    };
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (length <= 16) {
+        if (length >= 4) {
+            size_t shift = (length >> 3) << 2;
+            a = (read4(p) << 32) | read4(p + shift);
+            b = (read4(p + length - 4) << 32) | read4(p + length - 4 - shift);
+        } else if (length > 0) {
+            a = (static_cast<uint64_t>(p[0]) << 16) |
+                        (static_cast<uint64_t>(p[length >> 1]) << 8) | p[length - 1];
+        }
+    } else {
+        size_t left = length;
+        if (left > 48) {
+            uint64_t seed1 = seed;
+            uint64_t seed2 = seed;
+            do {
+                seed = wyhash_mix(read8(p) ^ WYHASH_SECRET[1], read8(p + 8) ^ seed);
+                seed1 = wyhash_mix(read8(p + 16) ^ WYHASH_SECRET[2], read8(p + 24) ^ seed1);
+                seed2 = wyhash_mix(read8(p + 32) ^ WYHASH_SECRET[3], read8(p + 40) ^ seed2);
+                p += 48;
+                left -= 48;
+            } while (left > 48);
+            seed ^= seed1 ^ seed2;
+        }
+        while (left > 16) {
+            seed = wyhash_mix(read8(p) ^ WYHASH_SECRET[1], read8(p + 8) ^ seed);
+            p += 16;
+            left -= 16;
+        }
+        a = read8(p + left - 16);
+        b = read8(p + left - 8);
+    }
+    a ^= WYHASH_SECRET[1];
+    b ^= seed;
+    wyhash_multiply(a, b);
+    return wyhash_mix(a ^ WYHASH_SECRET[0] ^ length, b ^ WYHASH_SECRET[1]);
+}
+
+// wyhash of length bytes. Time: O(length).
+inline uint64_t wyhash_bytes(const void* data, size_t length, uint64_t seed = 0) {
+    return wyhash_bytes_mixed(data, length, wyhash_mix_seed(seed));
+}
+
+/* Hash functor on top of wyhash. The seed changes all hashes, a random seed makes the table
+resistant to keys chosen to collide. */
+template<class KeyType, class = void>
+struct WyHash;
+
+template<class KeyType>
+struct WyHash<KeyType, typename std::enable_if<std::is_integral<KeyType>::value ||
+                                               std::is_enum<KeyType>::value ||
+                                               std::is_pointer<KeyType>::value>::type> {
+    explicit WyHash(uint64_t seed = 0) : seed_(seed) {}
+
+    size_t operator()(KeyType key) const {
+        if constexpr (std::is_pointer<KeyType>::value) {
+            return static_cast<size_t>(wyhash_64(reinterpret_cast<uintptr_t>(key), seed_));
+        } else {
+            return static_cast<size_t>(wyhash_64(static_cast<uint64_t>(key), seed_));
+        }
+    }
+
+    // Hash functions with the same seed give the same hashes. Time: O(1).
+    bool operator==(const WyHash& other) const {
+        return seed_ == other.seed_;
+    }
+
+ private:
+    uint64_t seed_;
+};
+
+// Strings are hashed as bytes. Transparent: std::string keys can be found by std::string_view.
+template<class KeyType>
+struct WyHash<KeyType, typename std::enable_if<
+                    std::is_convertible<const KeyType&, std::string_view>::value &&
+                    !std::is_pointer<KeyType>::value>::type> {
+    using is_transparent = void;
+
+    explicit WyHash(uint64_t seed = 0) : mixed_seed_(wyhash_mix_seed(seed)) {}
+
+    size_t operator()(std::string_view key) const {
+        return static_cast<size_t>(wyhash_bytes_mixed(key.data(), key.size(), mixed_seed_));
+    }
+
+    // Time: O(1).
+    bool operator==(const WyHash& other) const {
+        return mixed_seed_ == other.mixed_seed_;
+    }
+
+ private:
+    uint64_t mixed_seed_;
+};
+
+// is_transparent of MixedHash is the one of the hash function inside.
+template<class Hash, class = void>
+struct MixedHashTransparency {};
+
+template<class Hash>
+struct MixedHashTransparency<Hash, std::void_t<typename Hash::is_transparent>> {
+    using is_transparent = typename Hash::is_transparent;
+};
+
+/* Applies wyhash_64 mix after Hash, so identity and other weak hashes (sequential ids,
+aligned pointers, hashes with zero low bits) spread over all buckets with any sizing
+policy. Costs two multiplications per hash. */
+template<class Hash>
+class MixedHash : public MixedHashTransparency<Hash> {
+ public:
+    explicit MixedHash(const Hash& hasher = Hash()) : hasher_(hasher) {}
+
+    template<class K>
+    size_t operator()(const K& key) const {
+        return static_cast<size_t>(wyhash_64(static_cast<uint64_t>(hasher_(key))));
+    }
+
+    // The hash function inside. Time: O(1).
+    const Hash& inner() const {
+        return hasher_;
+    }
+
+    /* Mixed hashes are the same if the inner ones are: always for a stateless inner hash, by
+    its operator== otherwise (there is no operator== if the inner hash has none). Time: O(1). */
+    template<class H = Hash>
+    typename std::enable_if<std::is_empty<H>::value, bool>::type operator==(
+                            const MixedHash&) const {
+        return true;
+    }
+
+    template<class H = Hash>
+    auto operator==(const MixedHash& other) const -> typename std::enable_if<
+                            !std::is_empty<H>::value,
+                            decltype(std::declval<const H&>() == std::declval<const H&>())>::type {
+        return hasher_ == other.hasher_;
+    }
+
+ private:
+    Hash hasher_;
+};
+
+#endif  // HASH_FUNCTIONS_H_
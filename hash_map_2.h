@@ -1,327 +1,4613 @@
 // "Copyright[2020] <ivanik01@yandex.ru>"
+#ifndef HASH_MAP_2_H_
+#define HASH_MAP_2_H_
+
 #include <initializer_list>
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
 #include <exception>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <limits>
 #include <memory>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
-/* This class implements algorithm that is known as Hash Table.
-I used implementation with separate chaining using std::vector.
-Table doubles its size when the number of elements becomes more than INCREMENT_FACTOR_/REALLOCATION_FACTOR_
- of hash table capacity. Linear iteration is provided with two tables idea. The first one (hashed_pointers_)
-is a hash table and there I just keep indices of real data contained in the second table (value_store_)
-. Quantity of elements is equal to the size of the second table. Iterators know nothing about first hash 
-table. First table exists only for the fast search of elements but not for iteration. 
+#if __has_include(<memory_resource>)
+#include <memory_resource>
+#endif
+#if __has_include(<sys/mman.h>)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+#if defined(HASH_MAP_DEBUG)
+#include <cstdio>
+#endif
+#if __has_include(<version>)
+#include <version>
+#endif
+#if defined(__cpp_lib_ranges)
+#include <ranges>
+#endif
 
-You can read about it more using following link: https://en.wikipedia.org/wiki/Hash_table
-*/
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
 
-template<class KeyType, class ValueType, class Hash = std::hash<KeyType> >
-class HashMap {
+/* Bucket sizing policies. A sizing policy chooses supported bucket counts and maps
+hashes to buckets:
+    round(n)        (static) the smallest supported bucket count not less than n;
+    resize(n)       sets bucket count n, that was returned by round;
+    bucket(hash)    number of the bucket for the hash, less than bucket count. */
+
+// Any bucket count, bucket is hash % bucket count. One integer division per lookup.
+class ModuloSizing {
  public:
-    // This method creates empty hash table. Time: O(1).
-    HashMap(const Hash& hasher = Hash()) :
-                        value_store_(0),
-                        hashed_pointers_(1, std::vector<size_t>(0)),
-                        hasher_(hasher) {}
+    static size_t round(size_t requested) {
+        return std::max<size_t>(requested, 1);
+    }
 
-    /* This method creates hash table using elements between two given forward iterators (these iterators are
-    not connected with HashMap class, they can be iterators of any other class). 
-    Time: O(quantity of elements in table). */
-    template<class Forward_Iter>
-    HashMap(Forward_Iter first, Forward_Iter last,
-                    const Hash& hasher = Hash()) :
-                        value_store_(0),
-                        hashed_pointers_(1, std::vector<size_t>(0)),
-                        hasher_(hasher) {
-        for (; first != last; first++) {
-            insert(*first);
-        }
+    void resize(size_t bucket_count) {
+        bucket_count_ = bucket_count;
     }
 
-    /* This method creates hash table using elements in initializer list.
-    Time: O(quantity of elements in table). */
-    HashMap(std::initializer_list<std::pair<KeyType, ValueType>>
-                        init_list, const Hash& hasher = Hash()) :
-                                value_store_(0),
-                                hashed_pointers_(1, std::vector<size_t>(0)),
-                                hasher_(hasher)  {
-        for (auto elem : init_list) {
-            insert(elem);
+    size_t bucket(size_t hash) const {
+        return hash % bucket_count_;
+    }
+
+ private:
+    size_t bucket_count_ = 1;
+};
+
+/* Power of two bucket counts, bucket is low bits of the hash taken with a mask.
+Fastest, but needs a hash function with good low bits. */
+class PowerOfTwoSizing {
+ public:
+    static size_t round(size_t requested) {
+        size_t bucket_count = 1;
+        while (bucket_count < requested) {
+            bucket_count <<= 1;
         }
+        return bucket_count;
     }
 
-    /* This is forward iterator class. It helps to iterate in the data structure. 
-    Iterators work only with storage of real data and don't know about hash_table with 
-    indices. Iterators became invalid after inserting and erasing elements. It is better 
-    to use iterators than pointers. Each method works in O(1) time. */
-    class iterator {
-        friend class HashMap;
+    void resize(size_t bucket_count) {
+        mask_ = bucket_count - 1;
+    }
 
-     public:
+    size_t bucket(size_t hash) const {
+        return hash & mask_;
+    }
 
-        // Iterator constructor.
-        iterator(size_t index = 0, HashMap* my_hashmap = nullptr) :
-            index_(index), my_hashmap_(my_hashmap) {}
+ private:
+    size_t mask_ = 0;
+};
 
-        iterator& operator++() {
-            index_++;
-            return (*this);
-        }
-        iterator operator++(int) {
-            iterator copied = (*this);
-            index_++;
-            return copied;
-        }
+/* Power of two bucket counts, bucket is high bits of hash * 2^64 / golden ratio
+(Fibonacci hashing). The multiplication mixes all bits of the hash into the result,
+so it works well with identity hashes of integers and pointers. */
+class FibonacciSizing {
+ public:
+    static size_t round(size_t requested) {
+        return PowerOfTwoSizing::round(requested);
+    }
 
-        bool operator ==(const iterator& other) const {
-            return ((index_ == other.index_)
-                    && (my_hashmap_ == other.my_hashmap_));
+    void resize(size_t bucket_count) {
+        bits_ = 0;
+        while ((static_cast<size_t>(1) << bits_) < bucket_count) {
+            bits_++;
         }
+    }
 
-        bool operator !=(const iterator& other) const {
-            return !(*this == other);
-        }
+    // Two shifts instead of one, because shift by 64 is undefined for bits_ == 0.
+    size_t bucket(size_t hash) const {
+        uint64_t product = static_cast<uint64_t>(hash) * UINT64_C(11400714819323198485);
+        return static_cast<size_t>((product >> (63 - bits_)) >> 1);
+    }
 
-        std::pair<const KeyType, ValueType>& operator*() const {
-            return reinterpret_cast<std::pair<const KeyType, ValueType>&>
-                                        (my_hashmap_->value_store_[index_]);
-        }
+ private:
+    size_t bits_ = 0;
+};
 
-        std::pair<const KeyType, ValueType>* operator->() const {
-            return reinterpret_cast<std::pair<const KeyType, ValueType>*>
-                                        (&my_hashmap_->value_store_[index_]);
+/* Prime bucket counts from a fixed table, every prime is the smallest one not less than
+twice the previous. Bucket is hash % prime, computed with precomputed reciprocal
+(Lemire's fastmod) instead of division. The hash is folded to 32 bits first, so both
+halves of it matter. Good choice for hash functions with weak low bits. */
+class PrimeSizing {
+ public:
+    static size_t round(size_t requested) {
+        for (size_t i = 0; i < PRIME_COUNT_; i++) {
+            if (PRIMES_[i] >= requested) {
+                return PRIMES_[i];
+            }
         }
+        return PRIMES_[PRIME_COUNT_ - 1];
+    }
+
+    void resize(size_t bucket_count) {
+        prime_ = static_cast<uint32_t>(bucket_count);
+        reciprocal_ = UINT64_C(0xFFFFFFFFFFFFFFFF) / prime_ + 1;
+    }
+
+    size_t bucket(size_t hash) const {
+        uint64_t wide = static_cast<uint64_t>(hash);
+        uint32_t folded = static_cast<uint32_t>(wide ^ (wide >> 32));
+#if defined(__SIZEOF_INT128__)
+        uint64_t lowbits = reciprocal_ * folded;
+        return static_cast<size_t>(
+                    (static_cast<unsigned __int128>(lowbits) * prime_) >> 64);
+#else
+        return folded % prime_;
+#endif
+    }
+
+ private:
+    constexpr static size_t PRIME_COUNT_ = 32;
+    constexpr static uint32_t PRIMES_[PRIME_COUNT_] = {
+        1u, 2u, 5u, 11u, 23u, 47u, 97u, 197u, 397u, 797u, 1597u, 3203u, 6421u,
+        12853u, 25717u, 51437u, 102877u, 205759u, 411527u, 823117u, 1646237u,
+        3292489u, 6584983u, 13169977u, 26339969u, 52679969u, 105359939u,
+        210719881u, 421439783u, 842879579u, 1685759167u, 3371518343u};
+    uint32_t prime_ = 1;
+    // 2^64 / prime_ rounded up, it overflows to 0 for prime_ == 1, which is still right.
+    uint64_t reciprocal_ = 0;
+};
+
+// Member type is_transparent marks hash functions and comparators that accept any comparable key.
+template<class T, class = void>
+struct IsTransparent : std::false_type {};
+
+template<class T>
+struct IsTransparent<T, std::void_t<typename T::is_transparent>> : std::true_type {};
 
-        void operator=(const iterator& other) {
-            index_ = other.index_;
-            my_hashmap_ = other.my_hashmap_;
+// K, if both Hash and KeyEqual are transparent, otherwise substitution failure.
+template<class Hash, class KeyEqual, class K>
+using EnableIfTransparent = typename std::enable_if<
+            IsTransparent<Hash>::value && IsTransparent<KeyEqual>::value, K>::type;
+
+// Hash functions with state (a seed), that tell by operator== if they give the same hashes.
+template<class Hash, class = void>
+struct IsComparableHash : std::false_type {};
+
+template<class Hash>
+struct IsComparableHash<Hash, std::void_t<decltype(std::declval<const Hash&>() ==
+                                                   std::declval<const Hash&>())>> :
+                        std::true_type {};
+
+/* Iterators that can pass the range twice: forward by iterator_category or, for iterators whose
+references are proxies returned by value (input by category), by iterator_concept. */
+template<class Iter, class = void>
+struct IsMultiPass : std::is_base_of<std::forward_iterator_tag,
+                                     typename std::iterator_traits<Iter>::iterator_category> {};
+
+template<class Iter>
+struct IsMultiPass<Iter, std::void_t<typename Iter::iterator_concept>> :
+                    std::is_base_of<std::forward_iterator_tag, typename Iter::iterator_concept> {};
+
+/* True if the hash functions give the same hash of every key: they are of the same type and
+stateless or equal by operator==. Then hashes cached by one table are valid in the other.
+Time: O(1). */
+template<class Hash, class OtherHash>
+bool same_hashes(const Hash& hasher, const OtherHash& other_hasher) {
+    if constexpr (!std::is_same<Hash, OtherHash>::value) {
+        return false;
+    } else if constexpr (std::is_empty<Hash>::value) {
+        return true;
+    } else if constexpr (IsComparableHash<Hash>::value) {
+        return static_cast<bool>(hasher == other_hasher);
+    } else {
+        return false;
+    }
+}
+
+/* Executor runs tasks of parallel methods (HashMap::build_parallel, rehash_parallel).
+Its interface is:
+    concurrency()                number of tasks worth running at once;
+    executor(task_count, task)   calls task(i) for every i in [0, task_count), maybe concurrently,
+                                 and returns when all the calls are finished.
+A thread pool can be plugged in this way. ThreadExecutor starts std::thread's for every call.
+Tasks must not throw. */
+class ThreadExecutor {
+ public:
+    explicit ThreadExecutor(size_t thread_count = std::thread::hardware_concurrency()) :
+                        thread_count_(std::max<size_t>(thread_count, 1)) {}
+
+    size_t concurrency() const {
+        return thread_count_;
+    }
+
+    // The calling thread runs tasks too. Time: O(thread count) + time of the tasks.
+    template<class Task>
+    void operator()(size_t task_count, Task task) const {
+        std::atomic<size_t> next_task(0);
+        auto worker = [&]() {
+            for (size_t i = next_task++; i < task_count; i = next_task++) {
+                task(i);
+            }
+        };
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < std::min(thread_count_, task_count); i++) {
+            threads.emplace_back(worker);
         }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+    }
 
-        const size_t index() const {
-            return index_;
+ private:
+    size_t thread_count_;
+};
+
+// Number of chunks to split count items into for the executor.
+template<class Executor>
+size_t parallel_chunk_count(const Executor& executor, size_t count) {
+    constexpr size_t MIN_CHUNK = 4096;
+    return std::max<size_t>(1, std::min(executor.concurrency() * 4, count / MIN_CHUNK));
+}
+
+// The first item of the chunk, when count items are split into chunks equal parts.
+inline size_t chunk_begin(size_t count, size_t chunks, size_t chunk) {
+    return static_cast<size_t>(static_cast<unsigned long long>(count) * chunk / chunks);
+}
+
+/* Stable parallel partition of numbers 0..count-1 into parts by part_of(i) < parts. Returns
+the numbers grouped by part, every group in increasing order, and begins of the groups
+(parts + 1 numbers). Every chunk counts its numbers per part, prefix sums give every
+(part, chunk) pair its own place, and then chunks scatter their numbers without contention.
+Time: O(count + parts^2) work. */
+template<class PartOf, class Executor>
+std::pair<std::vector<size_t>, std::vector<size_t>> radix_partition(size_t count, size_t parts,
+                                            PartOf part_of, Executor& executor) {
+    size_t chunks = parts;
+    std::vector<size_t> offsets(chunks * parts, 0);
+    executor(chunks, [&](size_t chunk) {
+        for (size_t i = chunk_begin(count, chunks, chunk);
+                            i < chunk_begin(count, chunks, chunk + 1); i++) {
+            offsets[chunk * parts + part_of(i)]++;
         }
+    });
+    std::vector<size_t> part_begin(parts + 1, 0);
+    size_t total = 0;
+    for (size_t part = 0; part < parts; part++) {
+        part_begin[part] = total;
+        for (size_t chunk = 0; chunk < chunks; chunk++) {
+            size_t chunk_count = offsets[chunk * parts + part];
+            offsets[chunk * parts + part] = total;
+            total += chunk_count;
+        }
+    }
+    part_begin[parts] = total;
+    std::vector<size_t> order(count);
+    executor(chunks, [&](size_t chunk) {
+        for (size_t i = chunk_begin(count, chunks, chunk);
+                            i < chunk_begin(count, chunks, chunk + 1); i++) {
+            order[offsets[chunk * parts + part_of(i)]++] = i;
+        }
+    });
+    return {std::move(order), std::move(part_begin)};
+}
 
-     private:
-        size_t index_;
-        HashMap* my_hashmap_ = nullptr;
+/* Fills empty buckets with positions 0..elements-1 in parallel. Buckets are split into
+contiguous ranges, positions are radix partitioned by range and then every range is filled
+by one task, so no bucket is touched by two threads. Positions in every bucket are in
+increasing order, as after sequential rebuild. The allocator of buckets must be thread safe. */
+template<class Buckets, class Sizing, class HashOf, class Executor>
+void parallel_fill_buckets(Buckets& buckets, const Sizing& sizing, size_t elements,
+                           HashOf hash_of, Executor& executor) {
+    size_t ranges = std::min(parallel_chunk_count(executor, elements), buckets.size());
+    auto range_of = [&](size_t position) {
+        return static_cast<size_t>(static_cast<unsigned long long>(
+                    sizing.bucket(hash_of(position))) * ranges / buckets.size());
     };
+    auto partition = radix_partition(elements, ranges, range_of, executor);
+    executor(ranges, [&](size_t range) {
+        for (size_t i = partition.second[range]; i < partition.second[range + 1]; i++) {
+            size_t position = partition.first[i];
+            buckets[sizing.bucket(hash_of(position))].push_back(position);
+        }
+    });
+}
 
-    /* This is constant forward iterator class. It helps to iterate 
-    in the data structure. Iterators work only with storage of real data and don't know about hash_table
-    with indices. Also it is good alternative to constant pointers. Iterators became invalid after 
-    inserting and erasing elements. Each method works in O(1) time. */
-    class const_iterator {
-        friend class HashMap;
+// Hint to load the cache line with address for reading, does nothing without compiler support.
+inline void prefetch_memory(const void* address) {
+#if defined(__GNUC__) || defined(__clang__)
+    __builtin_prefetch(address, 0, 3);
+#else
+    (void)address;
+#endif
+}
 
-     public:
-        // Constant iterator constructor.
-        const_iterator(size_t index = 0,
-                       const HashMap* my_hashmap = nullptr) :
-            index_(index), my_hashmap_(my_hashmap) {}
+// Number of bits needed to write the value, 0 for 0. Time: O(log value).
+inline size_t bit_length(size_t value) {
+    size_t bits = 0;
+    for (; value != 0; value >>= 1) {
+        bits++;
+    }
+    return bits;
+}
 
-        const_iterator& operator++() {
-            index_++;
-            return (*this);
-        }
+/* Cluster length of linear probing, that a uniform hash practically never exceeds with
+elements in cells. Clusters longer than k appear with probability about exp(-k * rate),
+rate = load - 1 - ln(load), the limit is 4 * log2(elements) / rate, several times the expected
+longest cluster. */
+inline size_t probing_skew_limit(size_t elements, size_t cells) {
+    if (elements == 0 || cells == 0) {
+        return std::numeric_limits<size_t>::max();
+    }
+    double load = std::min(static_cast<double>(elements) / cells, 0.99);
+    return static_cast<size_t>(4 * bit_length(elements) / (load - 1 - std::log(load)));
+}
 
-        const_iterator operator++(int) {
-            const_iterator copied = (*this);
-            index_++;
-            return copied;
+/* Index policies. An index policy keeps positions of elements of value_store_ and
+finds them by hash. It knows nothing about keys and values, HashMap passes it hashes and
+small functors instead:
+    find(hash, match)                 returns the first position x with match(x) == true or NPOS;
+    prefetch(hash)                    prefetches memory, that find(hash, ...) reads first;
+    insert(hash, x, hash_of)          adds position x, which is known to be absent;
+    erase(hash, x, hash_of)           removes position x;
+    erase_match(hash, match, hash_of) removes the position, that find(hash, match) returns, in the
+                                      same probe and returns it (or NPOS);
+    replace(hash, x, y)               renames position x to y (the back element filled a hole);
+    rebuild(buckets, n, hash_of)      rebuilds the index for positions 0..n-1;
+    advance(hash_of)                  does a bounded part of postponed work (incremental rehash);
+    parallel_rebuild(buckets, n, hash_of, executor)
+                                      rebuild that may run on the executor;
+    reset()                           removes all positions, but keeps the buckets;
+    clear()                           removes all positions and frees the buckets;
+    max_chain_length()                the longest chain (bucket, cluster of cells or run of groups),
+                                      that find may walk;
+    for_each_chain(function)          calls function(length) for every chain, in the same units;
+    allocated_bytes()                 bytes of heap memory, that the index holds;
+    skew_limit(n)                     the longest chain, that a good hash practically never gives
+                                      for n positions, longer ones mean a skewed hash;
+    LOAD_FACTOR_LIMIT                 the largest max_load_factor HashMap may use with the index;
+    rebind<A>, with_sizing<S>         the same index with allocator A or sizing policy S;
+    bucket_count().
+hash_of(x) returns the hash of the key stored at position x. A new or cleared index has no
+buckets and allocates nothing, HashMap doesn't search it until the first rebuild. */
+
+// Size of the longest bucket in the array of buckets. Time: O(buckets.size()).
+template<class Buckets>
+size_t longest_bucket(const Buckets& buckets) {
+    size_t longest = 0;
+    for (auto& bucket : buckets) {
+        longest = std::max(longest, bucket.size());
+    }
+    return longest;
+}
+
+// Heap bytes of the array of buckets and of the buckets. Time: O(buckets.size()).
+template<class Buckets>
+size_t bucket_bytes(const Buckets& buckets) {
+    size_t bytes = buckets.capacity() * sizeof(buckets[0]);
+    for (auto& bucket : buckets) {
+        bytes += bucket.capacity() * sizeof(bucket[0]);
+    }
+    return bytes;
+}
+
+/* Chain length of separate chaining, that a uniform hash practically never exceeds with
+elements in bucket_count buckets. Bucket sizes are about Poisson distributed with mean
+load = elements / bucket_count, the limit is the smallest k with
+bucket_count * P(size > k) < 1e-6, the tail is bounded by P(size = k + 1) / (1 - load / (k + 2)).
+Logarithms keep it finite at any load. Time: O(limit). */
+inline size_t chain_skew_limit(size_t elements, size_t bucket_count) {
+    if (bucket_count == 0) {
+        return std::numeric_limits<size_t>::max();
+    }
+    double load = static_cast<double>(elements) / bucket_count;
+    double log_load = std::log(load);
+    double log_threshold = std::log(1e-6) - std::log(static_cast<double>(bucket_count));
+    double log_next = -load;  // log P(size = k + 1), k = -1
+    size_t limit = 0;
+    for (; limit < elements; limit++) {
+        log_next += log_load - std::log(static_cast<double>(limit + 1));
+        double ratio = load / static_cast<double>(limit + 2);
+        if (ratio < 1 && log_next - std::log(1 - ratio) < log_threshold) {
+            break;
         }
+    }
+    return limit;
+}
+
+/* Separate chaining: every bucket is std::vector of positions. Cheap inserts,
+but every bucket is its own heap allocation. */
+template<class Sizing = ModuloSizing, class Allocator = std::allocator<size_t>>
+class ChainedIndex {
+ public:
+    constexpr static size_t NPOS = static_cast<size_t>(-1);
+    // Chains just get longer, any load works.
+    constexpr static float LOAD_FACTOR_LIMIT = std::numeric_limits<float>::max();
+
+    // The same index with another allocator, HashMap passes its own allocator this way.
+    template<class OtherAllocator>
+    using rebind = ChainedIndex<Sizing, OtherAllocator>;
+
+    // The same index with another bucket sizing policy.
+    template<class OtherSizing>
+    using with_sizing = ChainedIndex<OtherSizing, Allocator>;
+
+    explicit ChainedIndex(const Allocator& allocator = Allocator()) :
+                        buckets_(BucketsAllocator(allocator)) {}
 
-        bool operator ==(const const_iterator& other) const {
-            return ((index_ == other.index_) &&
-                (my_hashmap_ == other.my_hashmap_));
+    // Time: O(1).
+    size_t bucket_count() const {
+        return buckets_.size();
+    }
+
+    // Time: O(length of the bucket).
+    template<class Match>
+    size_t find(size_t hash, Match match) const {
+        for (auto& x : buckets_[sizing_.bucket(hash)]) {
+            if (match(x)) {
+                return x;
+            }
         }
+        return NPOS;
+    }
 
-        bool operator !=(const const_iterator& other) const {
-            return !(*this == other);
+    // Time: O(1).
+    void prefetch(size_t hash) const {
+        prefetch_memory(&buckets_[sizing_.bucket(hash)]);
+    }
+
+    // Time: amortized O(1).
+    template<class HashOf>
+    void insert(size_t hash, size_t position, HashOf) {
+        buckets_[sizing_.bucket(hash)].push_back(position);
+    }
+
+    // Time: O(length of the bucket).
+    template<class HashOf>
+    void erase(size_t hash, size_t position, HashOf hash_of) {
+        erase_match(hash, [position](size_t x) { return x == position; }, hash_of);
+    }
+
+    // Time: O(length of the bucket).
+    template<class Match, class HashOf>
+    size_t erase_match(size_t hash, Match match, HashOf) {
+        auto& bucket = buckets_[sizing_.bucket(hash)];
+        for (auto& x : bucket) {
+            if (match(x)) {
+                size_t position = x;
+                x = bucket.back();
+                bucket.pop_back();
+                return position;
+            }
         }
+        return NPOS;
+    }
 
-        const std::pair<const KeyType, ValueType>& operator*() const {
-            return reinterpret_cast<const std::pair<const KeyType, ValueType>&>
-                                        (my_hashmap_->value_store_[index_]);
+    // Time: O(length of the bucket).
+    void replace(size_t hash, size_t old_position, size_t new_position) {
+        for (auto& x : buckets_[sizing_.bucket(hash)]) {
+            if (x == old_position) {
+                x = new_position;
+                return;
+            }
         }
+    }
 
-        const std::pair<const KeyType, ValueType>* operator->() const {
-            return reinterpret_cast<const std::pair<const KeyType, ValueType>*>
-                                         (&my_hashmap_->value_store_[index_]);
+    // Time: O(bucket_count + elements).
+    template<class HashOf>
+    void rebuild(size_t bucket_count, size_t elements, HashOf hash_of) {
+        bucket_count = Sizing::round(bucket_count);
+        sizing_.resize(bucket_count);
+        assign_buckets(buckets_, bucket_count);
+        for (size_t i = 0; i < elements; i++) {
+            buckets_[sizing_.bucket(hash_of(i))].push_back(i);
         }
+    }
+
+    // Ranges of buckets are filled by different tasks. Time: O(bucket_count + elements).
+    template<class HashOf, class Executor>
+    void parallel_rebuild(size_t bucket_count, size_t elements, HashOf hash_of,
+                          Executor& executor) {
+        bucket_count = Sizing::round(bucket_count);
+        sizing_.resize(bucket_count);
+        assign_buckets(buckets_, bucket_count);
+        parallel_fill_buckets(buckets_, sizing_, elements, hash_of, executor);
+    }
 
-        void operator =(const const_iterator& other) {
-            index_ = other.index_;
-            my_hashmap_ = other.my_hashmap_;
+    // Time: O(bucket_count).
+    void clear() {
+        sizing_.resize(1);
+        Buckets(buckets_.get_allocator()).swap(buckets_);
+    }
+
+    // Buckets keep their memory too. Time: O(bucket_count).
+    void reset() {
+        for (auto& bucket : buckets_) {
+            bucket.clear();
         }
+    }
 
-        const size_t index() const {
-            return index_;
+    // Length of the longest bucket. Time: O(bucket_count).
+    size_t max_chain_length() const {
+        return longest_bucket(buckets_);
+    }
+
+    // Sizes of all buckets, empty ones too. Time: O(bucket_count).
+    template<class Function>
+    void for_each_chain(Function function) const {
+        for (auto& bucket : buckets_) {
+            function(bucket.size());
         }
+    }
 
-     private:
-        size_t index_;
-        const HashMap* my_hashmap_ = nullptr;
-    };
+    // Time: O(bucket_count).
+    size_t allocated_bytes() const {
+        return bucket_bytes(buckets_);
+    }
 
-    // Time: O(1).
-    const size_t size() const {
-        return value_store_.size();
+    /* Bucket sizes are about Poisson distributed, a good hash stays below the Poisson tail
+    bound of chain_skew_limit. A hash that uses a small part of the buckets multiplies the
+    load of that part and goes far above it. Time: O(limit). */
+    size_t skew_limit(size_t elements) const {
+        return chain_skew_limit(elements, buckets_.size());
     }
 
-    // Time: O(1). 
-    const bool empty() const {
-        return value_store_.size() == 0;
+    // Nothing is postponed here. Time: O(1).
+    template<class HashOf>
+    void advance(HashOf) {}
+
+ private:
+    using Bucket = std::vector<size_t, Allocator>;
+    using BucketsAllocator = typename std::allocator_traits<Allocator>::template
+                                    rebind_alloc<Bucket>;
+    using Buckets = std::vector<Bucket, BucketsAllocator>;
+
+    Buckets buckets_;
+    Sizing sizing_;
+
+    /* Makes bucket_count empty buckets. Every bucket is moved in with the allocator of the
+    index, so stateful and polymorphic allocators reach the buckets too. */
+    static void assign_buckets(Buckets& buckets, size_t bucket_count) {
+        buckets.clear();
+        buckets.reserve(bucket_count);
+        for (size_t i = 0; i < bucket_count; i++) {
+            buckets.push_back(Bucket(Allocator(buckets.get_allocator())));
+        }
     }
+};
 
-    // Returns hash function, used by hash table. Time: O(1).
-    const Hash hash_function() const {
-        return hasher_;
+/* Separate chaining with incremental rehash, like dictionaries in Redis. On growth the new
+bucket array is allocated, but elements stay in the old one and every insert, erase and
+non-constant find moves at most MIGRATION_STEP_ old buckets into the new array. Until the move
+is done lookups check both arrays. So no single operation pays for rebuilding the whole table. */
+template<class Sizing = ModuloSizing, class Allocator = std::allocator<size_t>>
+class IncrementalChainedIndex {
+ public:
+    constexpr static size_t NPOS = static_cast<size_t>(-1);
+    // Chains just get longer, any load works.
+    constexpr static float LOAD_FACTOR_LIMIT = std::numeric_limits<float>::max();
+
+    // The same index with another allocator, HashMap passes its own allocator this way.
+    template<class OtherAllocator>
+    using rebind = IncrementalChainedIndex<Sizing, OtherAllocator>;
+
+    // The same index with another bucket sizing policy.
+    template<class OtherSizing>
+    using with_sizing = IncrementalChainedIndex<OtherSizing, Allocator>;
+
+    explicit IncrementalChainedIndex(const Allocator& allocator = Allocator()) :
+                        buckets_(BucketsAllocator(allocator)),
+                        old_buckets_(BucketsAllocator(allocator)) {}
+
+    // Bucket count of the table that is being filled. Time: O(1).
+    size_t bucket_count() const {
+        return buckets_.size();
     }
 
-    // Iterator points to the first element in hash_table. Time: O(1).
-    iterator begin() {
-        return {0, this};
+    // True while elements are being moved from the old bucket array. Time: O(1).
+    bool migrating() const {
+        return !old_buckets_.empty();
     }
 
-    // Constant iterator points to the first element in hash_table. Time: O(1).
-    const_iterator begin() const {
-        return {0, this};
+    // Time: O(length of the bucket).
+    template<class Match>
+    size_t find(size_t hash, Match match) const {
+        if (migrating()) {
+            size_t old_bucket = old_sizing_.bucket(hash);
+            if (old_bucket >= migrated_) {
+                for (auto& x : old_buckets_[old_bucket]) {
+                    if (match(x)) {
+                        return x;
+                    }
+                }
+            }
+        }
+        for (auto& x : buckets_[sizing_.bucket(hash)]) {
+            if (match(x)) {
+                return x;
+            }
+        }
+        return NPOS;
     }
 
-    // Iterator points behind the last element in hash_table. Time: O(1).
-    iterator end() {
-        return {value_store_.size(), this};
+    // Prefetches both buckets while migrating. Time: O(1).
+    void prefetch(size_t hash) const {
+        if (migrating()) {
+            prefetch_memory(&old_buckets_[old_sizing_.bucket(hash)]);
+        }
+        prefetch_memory(&buckets_[sizing_.bucket(hash)]);
     }
 
-    /* Constant iterator points behind the last 
-    element in hash_table. Time: O(1). */
-    const_iterator end() const {
-        return {value_store_.size(), this};
+    // Time: amortized O(1).
+    template<class HashOf>
+    void insert(size_t hash, size_t position, HashOf) {
+        buckets_[sizing_.bucket(hash)].push_back(position);
+        elements_++;
     }
 
-    /* Returns iterator to the element if this element is in
-     the table ot iterator end() otherwise. Time: expected O(1). */
-    iterator find(const KeyType& key) {
-        size_t current_hash = hasher_(key) % hashed_pointers_.size();
-        for (auto& x : hashed_pointers_[current_hash]) {
-            if (value_store_[x].first == key) {
-                return {x, this};
+    // Time: O(length of the bucket).
+    template<class HashOf>
+    void erase(size_t hash, size_t position, HashOf hash_of) {
+        erase_match(hash, [position](size_t x) { return x == position; }, hash_of);
+    }
+
+    // Looks in the old bucket first, as find does. Time: O(length of the bucket).
+    template<class Match, class HashOf>
+    size_t erase_match(size_t hash, Match match, HashOf) {
+        if (migrating()) {
+            size_t old_bucket = old_sizing_.bucket(hash);
+            if (old_bucket >= migrated_) {
+                size_t position = erase_from(old_buckets_[old_bucket], match);
+                if (position != NPOS) {
+                    return position;
+                }
             }
         }
-        return {value_store_.size(), this};
+        return erase_from(buckets_[sizing_.bucket(hash)], match);
     }
 
-    /* Returns constant iterator to the element if this element is in the 
-    table ot constant iterator end() otherwise. Time: expected O(1). */
-    const_iterator find(const KeyType& key) const {
-        size_t current_hash = hasher_(key) % hashed_pointers_.size();
-        for (auto& x : hashed_pointers_[current_hash]) {
-            if (value_store_[x].first == key) {
-                return { x, this };
+    // Time: O(length of the bucket).
+    void replace(size_t hash, size_t old_position, size_t new_position) {
+        Bucket* bucket = locate(hash, old_position);
+        if (bucket == nullptr) {
+            return;
+        }
+        for (auto& x : *bucket) {
+            if (x == old_position) {
+                x = new_position;
+                return;
             }
         }
-        return { value_store_.size(), this };
     }
 
-    /* Removes element from the hash_table. The size of storage 
-    doesn't change. Time: expected O(1). */
-    void erase(const KeyType& key) {
-        if (find(key) == end()) {
+    /* Starts moving elements into bucket_count new buckets. Unfinished move is completed
+    first. If the index doesn't hold exactly positions 0..elements-1 it is rebuilt at once.
+    Time: O(bucket_count), O(bucket_count + elements) for the immediate rebuild. */
+    template<class HashOf>
+    void rebuild(size_t bucket_count, size_t elements, HashOf hash_of) {
+        while (migrating()) {
+            advance(hash_of);
+        }
+        bucket_count = Sizing::round(bucket_count);
+        if (elements != elements_) {
+            sizing_.resize(bucket_count);
+            assign_buckets(buckets_, bucket_count);
+            for (size_t i = 0; i < elements; i++) {
+                buckets_[sizing_.bucket(hash_of(i))].push_back(i);
+            }
+            elements_ = elements;
             return;
-        } else {
-            auto curiter = find(key);
-            size_t hash0 = hasher_(key) % hashed_pointers_.size();
-            size_t hash1 = hasher_(value_store_.back().first) %
-                                    hashed_pointers_.size();
-            size_t index0 = curiter.index_;
-            size_t index1 = value_store_.size() - 1;
-            swap(value_store_[index0], value_store_.back());
-            value_store_.pop_back();
-            for (auto& x : hashed_pointers_[hash0]) {
-                if (x == index0) {
-                    std::swap(x, hashed_pointers_[hash0].back());
-                    hashed_pointers_[hash0].pop_back();
-                    break;
+        }
+        old_buckets_.swap(buckets_);
+        old_sizing_ = sizing_;
+        sizing_.resize(bucket_count);
+        assign_buckets(buckets_, bucket_count);
+        migrated_ = 0;
+        if (elements_ == 0) {
+            old_buckets_.clear();
+        }
+    }
+
+    /* Finishes unfinished move and rebuilds the index at once, ranges of buckets are
+    filled by different tasks. Time: O(bucket_count + elements). */
+    template<class HashOf, class Executor>
+    void parallel_rebuild(size_t bucket_count, size_t elements, HashOf hash_of,
+                          Executor& executor) {
+        while (migrating()) {
+            advance(hash_of);
+        }
+        bucket_count = Sizing::round(bucket_count);
+        sizing_.resize(bucket_count);
+        assign_buckets(buckets_, bucket_count);
+        parallel_fill_buckets(buckets_, sizing_, elements, hash_of, executor);
+        elements_ = elements;
+    }
+
+    /* Moves at most MIGRATION_STEP_ old buckets into the new array. Empty buckets are
+    cheaper, so up to EMPTY_VISITS_ of them are skipped in one call. Time: O(1) buckets. */
+    template<class HashOf>
+    void advance(HashOf hash_of) {
+        size_t moved = 0;
+        size_t visited = 0;
+        while (migrating() && moved < MIGRATION_STEP_ && visited < EMPTY_VISITS_) {
+            auto& bucket = old_buckets_[migrated_];
+            visited++;
+            if (!bucket.empty()) {
+                for (auto& x : bucket) {
+                    buckets_[sizing_.bucket(hash_of(x))].push_back(x);
                 }
+                Bucket(bucket.get_allocator()).swap(bucket);
+                moved++;
             }
-            for (auto& x : hashed_pointers_[hash1]) {
-                if (x == index1) {
-                    x = index0;
-                    break;
-                }
+            migrated_++;
+            if (migrated_ == old_buckets_.size()) {
+                Buckets(old_buckets_.get_allocator()).swap(old_buckets_);
+                migrated_ = 0;
             }
         }
     }
 
-    /* Inserts element into the hash table only if there was not such element.
-    Calls check_and_reallocate. Time: expected and amortized O(1).
-    O(quantity of elements in the table) while reallocation. */
-    void insert(const std::pair<KeyType, ValueType>& key_value) {
-        if (find(key_value.first) == end()) {
-            value_store_.push_back(key_value);
-            size_t current_hash = hasher_(key_value.first);
-            hashed_pointers_[current_hash % hashed_pointers_.size()].
-                push_back(value_store_.size() - 1);
-            check_and_reallocate();
-        }
-        return;
+    // Time: O(bucket_count).
+    void clear() {
+        sizing_.resize(1);
+        Buckets(buckets_.get_allocator()).swap(buckets_);
+        Buckets(old_buckets_.get_allocator()).swap(old_buckets_);
+        migrated_ = 0;
+        elements_ = 0;
     }
 
-    /* Returns reference to the value if this key is in the table. 
-    Throws out_of_range exception otherwise. Time: expected O(1) */
-    const ValueType& at(const KeyType& key) const {
-        if (find(key) == end()) {
-            throw std::out_of_range("This element doesn't exist");
-        } else {
-            return (*(find(key))).second;
+    // Unfinished move is dropped, new buckets keep their memory. Time: O(bucket_count).
+    void reset() {
+        for (auto& bucket : buckets_) {
+            bucket.clear();
         }
+        old_buckets_.clear();
+        migrated_ = 0;
+        elements_ = 0;
     }
 
-    /* Returns reference to the value if this key is in the table.
-    Otherwise put default value into hashtable. Time: expected O(1) */
-    ValueType& operator[](const KeyType& key) {
-        if (find(key) == end()) {
-            ValueType init = ValueType();
-            insert({ key, init });
-            return (*find(key)).second;
-        } else {
-            return (*find(key)).second;
+    // Length of the longest bucket of both arrays. Time: O(bucket_count).
+    size_t max_chain_length() const {
+        return std::max(longest_bucket(buckets_), longest_bucket(old_buckets_));
+    }
+
+    // Sizes of the new buckets and of the old ones, that are not moved yet. Time: O(bucket_count).
+    template<class Function>
+    void for_each_chain(Function function) const {
+        for (auto& bucket : buckets_) {
+            function(bucket.size());
+        }
+        for (size_t i = migrated_; i < old_buckets_.size(); i++) {
+            function(old_buckets_[i].size());
         }
     }
 
-    // Clears hash table. Time: O(quantity of elements in the table)
-    void clear() {
-        value_store_.clear();
-        hashed_pointers_.clear();
-        hashed_pointers_.resize(1);
+    // Both arrays while migrating. Time: O(bucket_count).
+    size_t allocated_bytes() const {
+        return bucket_bytes(buckets_) + bucket_bytes(old_buckets_);
+    }
+
+    /* The same as for ChainedIndex, but while migrating the smaller array has the larger
+    load, and its chains count in max_chain_length too. Time: O(limit). */
+    size_t skew_limit(size_t elements) const {
+        size_t buckets = buckets_.size();
+        if (!old_buckets_.empty()) {
+            buckets = std::min(buckets, old_buckets_.size());
+        }
+        return chain_skew_limit(elements, buckets);
     }
 
  private:
-    std::vector<std::pair<KeyType, ValueType>> value_store_;
-    std::vector<std::vector<size_t>> hashed_pointers_;
-    Hash hasher_;
-    constexpr static size_t INCREMENT_FACTOR_ = 2;
-    constexpr static size_t REALLOCATION_FACTOR_ = 3;
+    using Bucket = std::vector<size_t, Allocator>;
+    using BucketsAllocator = typename std::allocator_traits<Allocator>::template
+                                    rebind_alloc<Bucket>;
+    using Buckets = std::vector<Bucket, BucketsAllocator>;
 
-    /* This method rebuilds table when quantity of elements becomes more 
-     than INCREMENT_FACTOR_/REALLOCATION_FACTOR_ of hash table capacity. 
-     It increments size of the table in INCREMENT_FACTOR_ times. 
-     Time: O(quantity of elements in the table). */
-    void check_and_reallocate() {
-        if (REALLOCATION_FACTOR_ * value_store_.size() >= hashed_pointers_.size() * INCREMENT_FACTOR_) {
-            size_t new_size = hashed_pointers_.size() * INCREMENT_FACTOR_;
-            hashed_pointers_.clear();
-            hashed_pointers_.resize(new_size, std::vector<size_t>(0));
-            for (size_t i = 0; i < value_store_.size(); i++) {
-                int cur_position = hasher_(value_store_[i].first) % new_size;
-                hashed_pointers_[cur_position].push_back(i);
+    Buckets buckets_;
+    // Bucket array that is being emptied, its buckets before migrated_ are already moved.
+    Buckets old_buckets_;
+    Sizing sizing_;
+    Sizing old_sizing_;
+    size_t migrated_ = 0;
+    size_t elements_ = 0;
+    constexpr static size_t MIGRATION_STEP_ = 4;
+    constexpr static size_t EMPTY_VISITS_ = 10 * MIGRATION_STEP_;
+
+    /* Makes bucket_count empty buckets. Every bucket is moved in with the allocator of the
+    index, so stateful and polymorphic allocators reach the buckets too. */
+    static void assign_buckets(Buckets& buckets, size_t bucket_count) {
+        buckets.clear();
+        buckets.reserve(bucket_count);
+        for (size_t i = 0; i < bucket_count; i++) {
+            buckets.push_back(Bucket(Allocator(buckets.get_allocator())));
+        }
+    }
+
+    // Removes the first matching position from the bucket and returns it (or NPOS).
+    template<class Match>
+    size_t erase_from(Bucket& bucket, Match match) {
+        for (auto& x : bucket) {
+            if (match(x)) {
+                size_t position = x;
+                x = bucket.back();
+                bucket.pop_back();
+                elements_--;
+                return position;
             }
         }
-        return;
+        return NPOS;
+    }
+
+    // Bucket that holds the position, whichever array it is in.
+    Bucket* locate(size_t hash, size_t position) {
+        if (migrating()) {
+            size_t old_bucket = old_sizing_.bucket(hash);
+            if (old_bucket >= migrated_) {
+                auto& bucket = old_buckets_[old_bucket];
+                if (std::find(bucket.begin(), bucket.end(), position) != bucket.end()) {
+                    return &bucket;
+                }
+            }
+        }
+        return &buckets_[sizing_.bucket(hash)];
+    }
+};
+
+/* Open addressing with linear probing: all positions live in one flat array of cells,
+so there is no per-bucket allocation and a lookup touches one contiguous run of memory.
+A cell keeps position + 1, zero means empty cell. Erase uses backward shift, so there are
+no tombstones. HashMap keeps load below max_load_factor, which is at most LOAD_FACTOR_LIMIT, so
+the array always has an empty cell and probing terminates. */
+template<class Sizing = ModuloSizing, class Allocator = std::allocator<size_t>>
+class OpenAddressingIndex {
+ public:
+    constexpr static size_t NPOS = static_cast<size_t>(-1);
+    // There must be an empty cell, and long clusters make probing slow.
+    constexpr static float LOAD_FACTOR_LIMIT = 0.9f;
+
+    // The same index with another allocator, HashMap passes its own allocator this way.
+    template<class OtherAllocator>
+    using rebind = OpenAddressingIndex<Sizing, OtherAllocator>;
+
+    // The same index with another bucket sizing policy.
+    template<class OtherSizing>
+    using with_sizing = OpenAddressingIndex<OtherSizing, Allocator>;
+
+    explicit OpenAddressingIndex(const Allocator& allocator = Allocator()) :
+                        cells_(allocator) {}
+
+    // Time: O(1).
+    size_t bucket_count() const {
+        return cells_.size();
     }
+
+    // Time: O(length of the cluster).
+    template<class Match>
+    size_t find(size_t hash, Match match) const {
+        for (size_t cell = sizing_.bucket(hash); cells_[cell] != 0;
+                                                cell = next(cell)) {
+            if (match(cells_[cell] - 1)) {
+                return cells_[cell] - 1;
+            }
+        }
+        return NPOS;
+    }
+
+    // Time: O(1).
+    void prefetch(size_t hash) const {
+        prefetch_memory(&cells_[sizing_.bucket(hash)]);
+    }
+
+    // Time: O(length of the cluster).
+    template<class HashOf>
+    void insert(size_t hash, size_t position, HashOf) {
+        size_t cell = sizing_.bucket(hash);
+        while (cells_[cell] != 0) {
+            cell = next(cell);
+        }
+        cells_[cell] = position + 1;
+    }
+
+    /* Removes position and shifts the rest of the cluster back, so that every
+    element stays reachable from its home cell. Time: O(length of the cluster). */
+    template<class HashOf>
+    void erase(size_t hash, size_t position, HashOf hash_of) {
+        size_t cell = locate(hash, position);
+        if (cell != NPOS) {
+            erase_cell(cell, hash_of);
+        }
+    }
+
+    // Time: O(length of the cluster).
+    template<class Match, class HashOf>
+    size_t erase_match(size_t hash, Match match, HashOf hash_of) {
+        for (size_t cell = sizing_.bucket(hash); cells_[cell] != 0;
+                                                cell = next(cell)) {
+            if (match(cells_[cell] - 1)) {
+                size_t position = cells_[cell] - 1;
+                erase_cell(cell, hash_of);
+                return position;
+            }
+        }
+        return NPOS;
+    }
+
+    // Time: O(length of the cluster).
+    void replace(size_t hash, size_t old_position, size_t new_position) {
+        size_t cell = locate(hash, old_position);
+        if (cell != NPOS) {
+            cells_[cell] = new_position + 1;
+        }
+    }
+
+    // Time: O(bucket_count + elements).
+    template<class HashOf>
+    void rebuild(size_t bucket_count, size_t elements, HashOf hash_of) {
+        bucket_count = Sizing::round(bucket_count);
+        sizing_.resize(bucket_count);
+        cells_.assign(bucket_count, 0);
+        for (size_t i = 0; i < elements; i++) {
+            insert(hash_of(i), i, hash_of);
+        }
+    }
+
+    /* Probe sequences cross any split of the table, so the cells are filled by one thread.
+    Hashes are usually precomputed in parallel by the caller. Time: O(bucket_count + elements). */
+    template<class HashOf, class Executor>
+    void parallel_rebuild(size_t bucket_count, size_t elements, HashOf hash_of, Executor&) {
+        rebuild(bucket_count, elements, hash_of);
+    }
+
+    // Time: O(bucket_count).
+    void clear() {
+        sizing_.resize(1);
+        std::vector<size_t, Allocator>(cells_.get_allocator()).swap(cells_);
+    }
+
+    // Time: O(bucket_count).
+    void reset() {
+        std::fill(cells_.begin(), cells_.end(), 0);
+    }
+
+    // Longest run of full cells. Time: O(bucket_count).
+    size_t max_chain_length() const {
+        size_t longest = 0;
+        for_each_chain([&longest](size_t length) {
+            longest = std::max(longest, length);
+        });
+        return longest;
+    }
+
+    // Lengths of all clusters (runs of full cells). Time: O(bucket_count).
+    template<class Function>
+    void for_each_chain(Function function) const {
+        size_t start = 0;
+        while (start < cells_.size() && cells_[start] != 0) {
+            start++;
+        }
+        if (start == cells_.size()) {
+            if (start != 0) {
+                function(start);
+            }
+            return;
+        }
+        // The scan starts after an empty cell and ends on it, so no run wraps around its end.
+        size_t run = 0;
+        for (size_t i = 1; i <= cells_.size(); i++) {
+            if (cells_[(start + i) % cells_.size()] != 0) {
+                run++;
+            } else if (run != 0) {
+                function(run);
+                run = 0;
+            }
+        }
+    }
+
+    // Time: O(1).
+    size_t allocated_bytes() const {
+        return cells_.capacity() * sizeof(size_t);
+    }
+
+    // Time: O(1).
+    size_t skew_limit(size_t elements) const {
+        return probing_skew_limit(elements, cells_.size());
+    }
+
+    // Nothing is postponed here. Time: O(1).
+    template<class HashOf>
+    void advance(HashOf) {}
+
+ private:
+    std::vector<size_t, Allocator> cells_;
+    Sizing sizing_;
+
+    size_t next(size_t cell) const {
+        return (cell + 1 == cells_.size()) ? 0 : cell + 1;
+    }
+
+    // Empties the cell and shifts the rest of its cluster back.
+    template<class HashOf>
+    void erase_cell(size_t hole, HashOf hash_of) {
+        for (size_t cell = next(hole); cells_[cell] != 0; cell = next(cell)) {
+            size_t home = sizing_.bucket(hash_of(cells_[cell] - 1));
+            bool home_in_range = (hole < cell) ? (hole < home && home <= cell)
+                                               : (hole < home || home <= cell);
+            if (!home_in_range) {
+                cells_[hole] = cells_[cell];
+                hole = cell;
+            }
+        }
+        cells_[hole] = 0;
+    }
+
+    size_t locate(size_t hash, size_t position) const {
+        for (size_t cell = sizing_.bucket(hash); cells_[cell] != 0;
+                                                cell = next(cell)) {
+            if (cells_[cell] == position + 1) {
+                return cell;
+            }
+        }
+        return NPOS;
+    }
+};
+
+/* Group of control bytes, that is checked for matches at once with SSE2 (x86) or
+NEON (AArch64) and with a plain loop elsewhere. Control byte of a full cell keeps
+7 low bits of the hash, empty and deleted cells have the sign bit set. Every match
+method returns bit mask, bit i is set when the i-th byte matches. */
+class ControlGroup {
+ public:
+    constexpr static size_t WIDTH = 16;
+    constexpr static int8_t EMPTY = -128;
+    constexpr static int8_t DELETED = -2;
+
+    explicit ControlGroup(const int8_t* ctrl) {
+#if defined(__SSE2__)
+        ctrl_ = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        ctrl_ = vld1q_s8(ctrl);
+#else
+        std::copy(ctrl, ctrl + WIDTH, ctrl_);
+#endif
+    }
+
+    uint32_t match(int8_t fingerprint) const {
+#if defined(__SSE2__)
+        return _mm_movemask_epi8(
+                    _mm_cmpeq_epi8(ctrl_, _mm_set1_epi8(fingerprint)));
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        return to_mask(vceqq_s8(ctrl_, vdupq_n_s8(fingerprint)));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < WIDTH; i++) {
+            mask |= static_cast<uint32_t>(ctrl_[i] == fingerprint) << i;
+        }
+        return mask;
+#endif
+    }
+
+    uint32_t match_empty() const {
+        return match(EMPTY);
+    }
+
+    uint32_t match_empty_or_deleted() const {
+#if defined(__SSE2__)
+        return _mm_movemask_epi8(ctrl_);
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+        return to_mask(vcltzq_s8(ctrl_));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < WIDTH; i++) {
+            mask |= static_cast<uint32_t>(ctrl_[i] < 0) << i;
+        }
+        return mask;
+#endif
+    }
+
+    // Index of the lowest set bit of non-zero mask.
+    static size_t lowest_bit(uint32_t mask) {
+#if defined(__GNUC__)
+        return __builtin_ctz(mask);
+#else
+        size_t bit = 0;
+        while ((mask & 1) == 0) {
+            mask >>= 1;
+            bit++;
+        }
+        return bit;
+#endif
+    }
+
+ private:
+#if defined(__SSE2__)
+    __m128i ctrl_;
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    int8x16_t ctrl_;
+
+    static uint32_t to_mask(uint8x16_t matched) {
+        static const uint8_t BITS[WIDTH] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                            1, 2, 4, 8, 16, 32, 64, 128};
+        uint8x16_t bits = vandq_u8(matched, vld1q_u8(BITS));
+        return vaddv_u8(vget_low_u8(bits)) |
+                    (static_cast<uint32_t>(vaddv_u8(vget_high_u8(bits))) << 8);
+    }
+#else
+    int8_t ctrl_[WIDTH];
+#endif
+};
+
+/* Swiss table style open addressing. Cells are split into groups of ControlGroup::WIDTH,
+every cell has control byte with 7-bit fingerprint of the hash. Lookup checks the whole
+group of control bytes at once and compares keys (touches value_store_) only for
+fingerprint matches, so almost all misses never leave the control array. Groups are probed
+linearly. Erased cell becomes empty if its group still has an empty cell (then no probe
+sequence goes through this group), otherwise it becomes deleted. Deleted cells are reused by
+insert and are purged when they together with full cells take more than 7/8 of the table. */
+template<class Sizing = ModuloSizing, class Allocator = std::allocator<size_t>>
+class GroupProbingIndex {
+ public:
+    constexpr static size_t NPOS = static_cast<size_t>(-1);
+    /* Deleted cells are purged above 7/8 load. Full cells stay below 0.8, so a purge drops at
+    least 7.5% of the cells and inserts after erases at the highest load are amortized O(1). */
+    constexpr static float LOAD_FACTOR_LIMIT = 0.8f;
+
+    // The same index with another allocator, HashMap passes its own allocator this way.
+    template<class OtherAllocator>
+    using rebind = GroupProbingIndex<Sizing, OtherAllocator>;
+
+    // The same index with another bucket sizing policy.
+    template<class OtherSizing>
+    using with_sizing = GroupProbingIndex<OtherSizing, Allocator>;
+
+    explicit GroupProbingIndex(const Allocator& allocator = Allocator()) :
+                        ctrl_(CtrlAllocator(allocator)),
+                        cells_(allocator) {}
+
+    // Time: O(1).
+    size_t bucket_count() const {
+        return ctrl_.size();
+    }
+
+    // Time: O(number of probed groups).
+    template<class Match>
+    size_t find(size_t hash, Match match) const {
+        size_t cell = locate_match(hash, match);
+        return (cell == NPOS) ? NPOS : cells_[cell];
+    }
+
+    // Prefetches control bytes and cells of the home group. Time: O(1).
+    void prefetch(size_t hash) const {
+        size_t first = home_group(hash) * ControlGroup::WIDTH;
+        prefetch_memory(&ctrl_[first]);
+        prefetch_memory(&cells_[first]);
+    }
+
+    // Time: O(number of probed groups), O(bucket_count) while purge of deleted cells.
+    template<class HashOf>
+    void insert(size_t hash, size_t position, HashOf hash_of) {
+        if (deleted_ != 0 && 8 * (full_ + deleted_ + 1) > 7 * ctrl_.size()) {
+            purge(hash_of);
+        }
+        size_t group = home_group(hash);
+        while (true) {
+            size_t first = group * ControlGroup::WIDTH;
+            uint32_t mask = ControlGroup(&ctrl_[first]).match_empty_or_deleted();
+            if (mask != 0) {
+                size_t cell = first + ControlGroup::lowest_bit(mask);
+                if (ctrl_[cell] == ControlGroup::DELETED) {
+                    deleted_--;
+                }
+                ctrl_[cell] = fingerprint(hash);
+                cells_[cell] = position;
+                full_++;
+                return;
+            }
+            group = next_group(group);
+        }
+    }
+
+    // Time: O(number of probed groups).
+    template<class HashOf>
+    void erase(size_t hash, size_t position, HashOf) {
+        size_t cell = locate(hash, position);
+        if (cell != NPOS) {
+            erase_cell(cell);
+        }
+    }
+
+    // Time: O(number of probed groups).
+    template<class Match, class HashOf>
+    size_t erase_match(size_t hash, Match match, HashOf) {
+        size_t cell = locate_match(hash, match);
+        if (cell == NPOS) {
+            return NPOS;
+        }
+        erase_cell(cell);
+        return cells_[cell];
+    }
+
+    // Time: O(number of probed groups).
+    void replace(size_t hash, size_t old_position, size_t new_position) {
+        size_t cell = locate(hash, old_position);
+        if (cell != NPOS) {
+            cells_[cell] = new_position;
+        }
+    }
+
+    // Time: O(bucket_count + elements).
+    template<class HashOf>
+    void rebuild(size_t bucket_count, size_t elements, HashOf hash_of) {
+        size_t groups = Sizing::round(
+            (bucket_count + ControlGroup::WIDTH - 1) / ControlGroup::WIDTH);
+        sizing_.resize(groups);
+        ctrl_.assign(groups * ControlGroup::WIDTH, ControlGroup::EMPTY);
+        cells_.assign(groups * ControlGroup::WIDTH, 0);
+        full_ = 0;
+        deleted_ = 0;
+        for (size_t i = 0; i < elements; i++) {
+            insert(hash_of(i), i, hash_of);
+        }
+    }
+
+    /* Probe sequences cross any split of the table, so the cells are filled by one thread.
+    Hashes are usually precomputed in parallel by the caller. Time: O(bucket_count + elements). */
+    template<class HashOf, class Executor>
+    void parallel_rebuild(size_t bucket_count, size_t elements, HashOf hash_of, Executor&) {
+        rebuild(bucket_count, elements, hash_of);
+    }
+
+    // Time: O(bucket_count).
+    void clear() {
+        sizing_.resize(1);
+        std::vector<int8_t, CtrlAllocator>(ctrl_.get_allocator()).swap(ctrl_);
+        std::vector<size_t, Allocator>(cells_.get_allocator()).swap(cells_);
+        full_ = 0;
+        deleted_ = 0;
+    }
+
+    // Time: O(bucket_count).
+    void reset() {
+        std::fill(ctrl_.begin(), ctrl_.end(), ControlGroup::EMPTY);
+        full_ = 0;
+        deleted_ = 0;
+    }
+
+    /* Number of groups, that the longest probe reads: the longest run of groups without an
+    empty cell and the group after it. Time: O(bucket_count). */
+    size_t max_chain_length() const {
+        size_t longest = 0;
+        for_each_chain([&longest](size_t length) {
+            longest = std::max(longest, length);
+        });
+        return longest;
+    }
+
+    /* For every group with an empty cell: the number of groups, that a probe ending there
+    reads (the run of groups without an empty cell before it and the group).
+    Time: O(bucket_count). */
+    template<class Function>
+    void for_each_chain(Function function) const {
+        size_t groups = group_count();
+        size_t start = 0;
+        while (start < groups && !has_empty(start)) {
+            start++;
+        }
+        if (start == groups) {
+            if (groups != 0) {
+                function(groups);
+            }
+            return;
+        }
+        // The scan starts after a group with an empty cell, so no run wraps around its end.
+        size_t run = 0;
+        for (size_t i = 1; i <= groups; i++) {
+            if (has_empty((start + i) % groups)) {
+                function(run + 1);
+                run = 0;
+            } else {
+                run++;
+            }
+        }
+    }
+
+    // Control bytes and cells. Time: O(1).
+    size_t allocated_bytes() const {
+        return ctrl_.capacity() + cells_.capacity() * sizeof(size_t);
+    }
+
+    // Clusters of cells as with linear probing, counted in groups. Time: O(1).
+    size_t skew_limit(size_t elements) const {
+        size_t cells = probing_skew_limit(elements, ctrl_.size());
+        return (cells == std::numeric_limits<size_t>::max()) ? cells
+                                                              : cells / ControlGroup::WIDTH + 1;
+    }
+
+    // Nothing is postponed here. Time: O(1).
+    template<class HashOf>
+    void advance(HashOf) {}
+
+ private:
+    using CtrlAllocator = typename std::allocator_traits<Allocator>::template rebind_alloc<int8_t>;
+
+    std::vector<int8_t, CtrlAllocator> ctrl_;
+    std::vector<size_t, Allocator> cells_;
+    // Maps hashes to groups, not to cells.
+    Sizing sizing_;
+    size_t full_ = 0;
+    size_t deleted_ = 0;
+
+    static int8_t fingerprint(size_t hash) {
+        return static_cast<int8_t>(hash & 0x7F);
+    }
+
+    size_t group_count() const {
+        return ctrl_.size() / ControlGroup::WIDTH;
+    }
+
+    size_t home_group(size_t hash) const {
+        return sizing_.bucket(hash >> 7);
+    }
+
+    size_t next_group(size_t group) const {
+        return (group + 1 == group_count()) ? 0 : group + 1;
+    }
+
+    bool has_empty(size_t group) const {
+        return ControlGroup(&ctrl_[group * ControlGroup::WIDTH]).match_empty() != 0;
+    }
+
+    size_t locate(size_t hash, size_t position) const {
+        return locate_match(hash, [position](size_t x) { return x == position; });
+    }
+
+    // Cell of the first full cell with the fingerprint of the hash and match(position).
+    template<class Match>
+    size_t locate_match(size_t hash, Match match) const {
+        size_t group = home_group(hash);
+        for (size_t probes = 0; probes < group_count(); probes++) {
+            size_t first = group * ControlGroup::WIDTH;
+            ControlGroup control(&ctrl_[first]);
+            for (uint32_t mask = control.match(fingerprint(hash)); mask != 0;
+                                                        mask &= mask - 1) {
+                size_t cell = first + ControlGroup::lowest_bit(mask);
+                if (match(cells_[cell])) {
+                    return cell;
+                }
+            }
+            if (control.match_empty() != 0) {
+                return NPOS;
+            }
+            group = next_group(group);
+        }
+        return NPOS;
+    }
+
+    /* Empty cell stops probing, so the cell becomes empty only if its group already had an
+    empty cell, otherwise it is deleted. */
+    void erase_cell(size_t cell) {
+        size_t first = cell - cell % ControlGroup::WIDTH;
+        if (ControlGroup(&ctrl_[first]).match_empty() != 0) {
+            ctrl_[cell] = ControlGroup::EMPTY;
+        } else {
+            ctrl_[cell] = ControlGroup::DELETED;
+            deleted_++;
+        }
+        full_--;
+    }
+
+    // Rebuilds the table of the same size without deleted cells.
+    template<class HashOf>
+    void purge(HashOf hash_of) {
+        std::vector<size_t, Allocator> positions(cells_.get_allocator());
+        positions.reserve(full_);
+        for (size_t cell = 0; cell < ctrl_.size(); cell++) {
+            if (ctrl_[cell] >= 0) {
+                positions.push_back(cells_[cell]);
+            }
+        }
+        ctrl_.assign(ctrl_.size(), ControlGroup::EMPTY);
+        full_ = 0;
+        deleted_ = 0;
+        for (size_t position : positions) {
+            insert(hash_of(position), position, hash_of);
+        }
+    }
+};
+
+/* Storage policies. A storage policy keeps elements of HashMap densely at positions
+0..size()-1, the index refers to them by position and iterators are positions too:
+    store<KeyType, ValueType, Allocator>  storage type, the allocator is rebound inside;
+    key(x), value(x)                      key and value at position x;
+    movable_key(x)                        rvalue reference to the key at x, to move elements out;
+    element(x)                            ElementReference to position x, that iterators return;
+    emplace_back(key, args...)            appends key and value constructed from args;
+    assign(x, key, value)                 assigns key and value to existing position x;
+    pop_back_into(x)                      moves the back element to position x and removes the back;
+    swap_elements(x, y)                   swaps elements at positions x and y;
+    move_into(x, y)                       move assigns the element at position x to position y;
+    truncate(n)                           removes the elements at positions n..size()-1;
+    keys(), values()                      random access ranges over all keys and all values;
+    INLINE_CAPACITY                       up to this size HashMap scans the store, keeping no index;
+    allocated_bytes()                     heap bytes of the arrays (not of what elements own);
+    size(), reserve(n), resize(n), clear(), shrink_to_fit(), get_allocator(). */
+
+// Pair of iterators, that can be used in range-based for. Time: O(1) for each method.
+template<class Iterator>
+class IteratorRange {
+ public:
+    IteratorRange() = default;
+
+    IteratorRange(Iterator first, Iterator last) : first_(first), last_(last) {}
+
+    Iterator begin() const {
+        return first_;
+    }
+
+    Iterator end() const {
+        return last_;
+    }
+
+    size_t size() const {
+        return static_cast<size_t>(last_ - first_);
+    }
+
+ private:
+    Iterator first_{};
+    Iterator last_{};
+};
+
+#if defined(__cpp_lib_ranges)
+// IteratorRange doesn't own the elements, so it is a view for ranges pipelines.
+template<class Iterator>
+inline constexpr bool std::ranges::enable_borrowed_range<IteratorRange<Iterator>> = true;
+
+template<class Iterator>
+inline constexpr bool std::ranges::enable_view<IteratorRange<Iterator>> = true;
+#endif
+
+/* Random access iterator over keys (Field = 0) or values (Field = 1) of an array of pairs.
+Pair is const for constant iterators. Each method works in O(1) time. */
+template<class Pair, size_t Field>
+class FieldIterator {
+ public:
+    using reference = decltype(std::get<Field>(std::declval<Pair&>()));
+    using value_type = typename std::remove_cv<typename std::remove_reference<reference>::type>::type;
+    using pointer = typename std::remove_reference<reference>::type*;
+    using difference_type = std::ptrdiff_t;
+    using iterator_category = std::random_access_iterator_tag;
+
+    explicit FieldIterator(Pair* pair = nullptr) : pair_(pair) {}
+
+    reference operator*() const {
+        return std::get<Field>(*pair_);
+    }
+
+    pointer operator->() const {
+        return &std::get<Field>(*pair_);
+    }
+
+    reference operator[](difference_type n) const {
+        return std::get<Field>(pair_[n]);
+    }
+
+    FieldIterator& operator++() {
+        ++pair_;
+        return *this;
+    }
+
+    FieldIterator operator++(int) {
+        return FieldIterator(pair_++);
+    }
+
+    FieldIterator& operator--() {
+        --pair_;
+        return *this;
+    }
+
+    FieldIterator operator--(int) {
+        return FieldIterator(pair_--);
+    }
+
+    FieldIterator& operator+=(difference_type n) {
+        pair_ += n;
+        return *this;
+    }
+
+    FieldIterator& operator-=(difference_type n) {
+        pair_ -= n;
+        return *this;
+    }
+
+    FieldIterator operator+(difference_type n) const {
+        return FieldIterator(pair_ + n);
+    }
+
+    friend FieldIterator operator+(difference_type n, const FieldIterator& iter) {
+        return iter + n;
+    }
+
+    FieldIterator operator-(difference_type n) const {
+        return FieldIterator(pair_ - n);
+    }
+
+    difference_type operator-(const FieldIterator& other) const {
+        return pair_ - other.pair_;
+    }
+
+    bool operator==(const FieldIterator& other) const {
+        return pair_ == other.pair_;
+    }
+
+    bool operator!=(const FieldIterator& other) const {
+        return pair_ != other.pair_;
+    }
+
+    bool operator<(const FieldIterator& other) const {
+        return pair_ < other.pair_;
+    }
+
+    bool operator>(const FieldIterator& other) const {
+        return pair_ > other.pair_;
+    }
+
+    bool operator<=(const FieldIterator& other) const {
+        return pair_ <= other.pair_;
+    }
+
+    bool operator>=(const FieldIterator& other) const {
+        return pair_ >= other.pair_;
+    }
+
+ private:
+    Pair* pair_;
+};
+
+/* Reference to an element of a storage, that iterators of HashMap return by value (as
+std::flat_map does). It has members first and second like std::pair<const KeyType, ValueType>&
+has, and converts to std::pair copy. ValueType is const for constant iterators. */
+template<class KeyType, class ValueType>
+struct ElementReference {
+    const KeyType& first;
+    ValueType& second;
+
+    operator std::pair<KeyType, typename std::remove_const<ValueType>::type>() const {
+        return {first, second};
+    }
+
+    operator std::pair<const KeyType, typename std::remove_const<ValueType>::type>() const {
+        return {first, second};
+    }
+};
+
+// Result of iterator operator-> when the iterator returns references by value.
+template<class Reference>
+class ArrowProxy {
+ public:
+    explicit ArrowProxy(Reference reference) : reference_(reference) {}
+
+    const Reference* operator->() const {
+        return &reference_;
+    }
+
+ private:
+    Reference reference_;
+};
+
+/* Elements are std::pair's in one std::vector, the key and the value of
+an element share cache lines. */
+template<class KeyType, class ValueType, class Allocator>
+class PairStore {
+    using Element = std::pair<KeyType, ValueType>;
+    using ElementAllocator = typename std::allocator_traits<Allocator>::template
+                                    rebind_alloc<Element>;
+
+ public:
+    using reference = ElementReference<KeyType, ValueType>;
+    using const_reference = ElementReference<KeyType, const ValueType>;
+    using key_iterator = FieldIterator<const Element, 0>;
+    using value_iterator = FieldIterator<Element, 1>;
+    using const_value_iterator = FieldIterator<const Element, 1>;
+    // Elements are always on the heap.
+    constexpr static size_t INLINE_CAPACITY = 0;
+
+    explicit PairStore(const Allocator& allocator) : elements_(ElementAllocator(allocator)) {}
+
+    size_t size() const {
+        return elements_.size();
+    }
+
+    void reserve(size_t count) {
+        elements_.reserve(count);
+    }
+
+    void resize(size_t count) {
+        elements_.resize(count);
+    }
+
+    void clear() {
+        elements_.clear();
+    }
+
+    void shrink_to_fit() {
+        elements_.shrink_to_fit();
+    }
+
+    ElementAllocator get_allocator() const {
+        return elements_.get_allocator();
+    }
+
+    size_t allocated_bytes() const {
+        return elements_.capacity() * sizeof(Element);
+    }
+
+    const KeyType& key(size_t position) const {
+        return elements_[position].first;
+    }
+
+    KeyType&& movable_key(size_t position) {
+        return std::move(elements_[position].first);
+    }
+
+    ValueType& value(size_t position) {
+        return elements_[position].second;
+    }
+
+    const ValueType& value(size_t position) const {
+        return elements_[position].second;
+    }
+
+    reference element(size_t position) {
+        return {elements_[position].first, elements_[position].second};
+    }
+
+    const_reference element(size_t position) const {
+        return {elements_[position].first, elements_[position].second};
+    }
+
+    // Time: amortized O(1).
+    template<class Key, class... Args>
+    void emplace_back(Key&& key, Args&&... args) {
+        elements_.emplace_back(std::piecewise_construct,
+                               std::forward_as_tuple(std::forward<Key>(key)),
+                               std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template<class Key, class Value>
+    void assign(size_t position, Key&& key, Value&& value) {
+        elements_[position].first = std::forward<Key>(key);
+        elements_[position].second = std::forward<Value>(value);
+    }
+
+    // Time: O(1).
+    void swap_elements(size_t first, size_t second) {
+        std::swap(elements_[first], elements_[second]);
+    }
+
+    // Time: O(1).
+    void pop_back_into(size_t position) {
+        if (position + 1 != elements_.size()) {
+            elements_[position] = std::move(elements_.back());
+        }
+        elements_.pop_back();
+    }
+
+    // Time: O(1).
+    void move_into(size_t from, size_t to) {
+        elements_[to] = std::move(elements_[from]);
+    }
+
+    // Time: O(size - count).
+    void truncate(size_t count) {
+        elements_.erase(elements_.begin() + count, elements_.end());
+    }
+
+    IteratorRange<key_iterator> keys() const {
+        return {key_iterator(elements_.data()), key_iterator(elements_.data() + elements_.size())};
+    }
+
+    IteratorRange<value_iterator> values() {
+        return {value_iterator(elements_.data()),
+                value_iterator(elements_.data() + elements_.size())};
+    }
+
+    IteratorRange<const_value_iterator> values() const {
+        return {const_value_iterator(elements_.data()),
+                const_value_iterator(elements_.data() + elements_.size())};
+    }
+
+ private:
+    std::vector<Element, ElementAllocator> elements_;
+};
+
+/* Keys and values are kept in two parallel std::vector's. Searches compare only keys, so
+they read the dense key array and never pull values into cache, and scans over keys() or
+values() read only one array, which the compiler can vectorize (both are plain pointers). */
+template<class KeyType, class ValueType, class Allocator>
+class SplitStore {
+    static_assert(!std::is_same<ValueType, bool>::value,
+                  "std::vector<bool> can't be used as value array, use char instead");
+    using KeyAllocator = typename std::allocator_traits<Allocator>::template
+                                    rebind_alloc<KeyType>;
+    using ValueAllocator = typename std::allocator_traits<Allocator>::template
+                                    rebind_alloc<ValueType>;
+
+ public:
+    using reference = ElementReference<KeyType, ValueType>;
+    using const_reference = ElementReference<KeyType, const ValueType>;
+    using key_iterator = const KeyType*;
+    using value_iterator = ValueType*;
+    using const_value_iterator = const ValueType*;
+    // Elements are always on the heap.
+    constexpr static size_t INLINE_CAPACITY = 0;
+
+    explicit SplitStore(const Allocator& allocator) :
+                        keys_(KeyAllocator(allocator)),
+                        values_(ValueAllocator(allocator)) {}
+
+    size_t size() const {
+        return keys_.size();
+    }
+
+    void reserve(size_t count) {
+        keys_.reserve(count);
+        values_.reserve(count);
+    }
+
+    void resize(size_t count) {
+        keys_.resize(count);
+        values_.resize(count);
+    }
+
+    void clear() {
+        keys_.clear();
+        values_.clear();
+    }
+
+    void shrink_to_fit() {
+        keys_.shrink_to_fit();
+        values_.shrink_to_fit();
+    }
+
+    KeyAllocator get_allocator() const {
+        return keys_.get_allocator();
+    }
+
+    size_t allocated_bytes() const {
+        return keys_.capacity() * sizeof(KeyType) + values_.capacity() * sizeof(ValueType);
+    }
+
+    const KeyType& key(size_t position) const {
+        return keys_[position];
+    }
+
+    KeyType&& movable_key(size_t position) {
+        return std::move(keys_[position]);
+    }
+
+    ValueType& value(size_t position) {
+        return values_[position];
+    }
+
+    const ValueType& value(size_t position) const {
+        return values_[position];
+    }
+
+    reference element(size_t position) {
+        return {keys_[position], values_[position]};
+    }
+
+    const_reference element(size_t position) const {
+        return {keys_[position], values_[position]};
+    }
+
+    // If construction of the value throws, the key is removed. Time: amortized O(1).
+    template<class Key, class... Args>
+    void emplace_back(Key&& key, Args&&... args) {
+        keys_.emplace_back(std::forward<Key>(key));
+        try {
+            values_.emplace_back(std::forward<Args>(args)...);
+        } catch (...) {
+            keys_.pop_back();
+            throw;
+        }
+    }
+
+    template<class Key, class Value>
+    void assign(size_t position, Key&& key, Value&& value) {
+        keys_[position] = std::forward<Key>(key);
+        values_[position] = std::forward<Value>(value);
+    }
+
+    // Time: O(1).
+    void swap_elements(size_t first, size_t second) {
+        std::swap(keys_[first], keys_[second]);
+        std::swap(values_[first], values_[second]);
+    }
+
+    // Time: O(1).
+    void pop_back_into(size_t position) {
+        if (position + 1 != keys_.size()) {
+            keys_[position] = std::move(keys_.back());
+            values_[position] = std::move(values_.back());
+        }
+        keys_.pop_back();
+        values_.pop_back();
+    }
+
+    // Time: O(1).
+    void move_into(size_t from, size_t to) {
+        keys_[to] = std::move(keys_[from]);
+        values_[to] = std::move(values_[from]);
+    }
+
+    // Time: O(size - count).
+    void truncate(size_t count) {
+        keys_.erase(keys_.begin() + count, keys_.end());
+        values_.erase(values_.begin() + count, values_.end());
+    }
+
+    IteratorRange<key_iterator> keys() const {
+        return {keys_.data(), keys_.data() + keys_.size()};
+    }
+
+    IteratorRange<value_iterator> values() {
+        return {values_.data(), values_.data() + values_.size()};
+    }
+
+    IteratorRange<const_value_iterator> values() const {
+        return {values_.data(), values_.data() + values_.size()};
+    }
+
+ private:
+    std::vector<KeyType, KeyAllocator> keys_;
+    std::vector<ValueType, ValueAllocator> values_;
+};
+
+/* Elements are std::pair's in a buffer of N elements inside the object, so a table of up to
+N elements makes no allocations at all. When the N+1-th element comes all of them are moved
+into std::vector on the heap, and they stay there until shrink_to_fit finds at most N of them.
+Inline elements are constructed with the allocator too (it only isn't asked for memory). */
+template<class KeyType, class ValueType, class Allocator, size_t N>
+class InlinePairStore {
+    static_assert(N > 0, "inline buffer must hold at least one element");
+    using Element = std::pair<KeyType, ValueType>;
+    using ElementAllocator = typename std::allocator_traits<Allocator>::template
+                                    rebind_alloc<Element>;
+    using Traits = std::allocator_traits<ElementAllocator>;
+
+ public:
+    using reference = ElementReference<KeyType, ValueType>;
+    using const_reference = ElementReference<KeyType, const ValueType>;
+    using key_iterator = FieldIterator<const Element, 0>;
+    using value_iterator = FieldIterator<Element, 1>;
+    using const_value_iterator = FieldIterator<const Element, 1>;
+    constexpr static size_t INLINE_CAPACITY = N;
+
+    explicit InlinePairStore(const Allocator& allocator) : heap_(ElementAllocator(allocator)) {}
+
+    // Time: O(size).
+    InlinePairStore(const InlinePairStore& other) :
+                        heap_(other.heap_),
+                        on_heap_(other.on_heap_) {
+        if (!on_heap_) {
+            append_inline(other.inline_data(), other.size_);
+        }
+    }
+
+    // Inline elements are moved one by one, the other store is left empty. Time: O(size).
+    InlinePairStore(InlinePairStore&& other)
+                        noexcept(std::is_nothrow_move_constructible<Element>::value) :
+                        heap_(std::move(other.heap_)),
+                        on_heap_(other.on_heap_) {
+        if (!on_heap_) {
+            append_inline(std::make_move_iterator(other.inline_data()), other.size_);
+            other.destroy_inline();
+        }
+    }
+
+    // Time: O(size + other.size()).
+    InlinePairStore& operator=(const InlinePairStore& other) {
+        if (this != &other) {
+            destroy_inline();
+            heap_ = other.heap_;
+            on_heap_ = other.on_heap_;
+            if (!on_heap_) {
+                append_inline(other.inline_data(), other.size_);
+            }
+        }
+        return *this;
+    }
+
+    // Time: O(size + other.size()).
+    InlinePairStore& operator=(InlinePairStore&& other) noexcept(
+                        std::is_nothrow_move_constructible<Element>::value &&
+                        std::is_nothrow_move_assignable<decltype(heap_)>::value) {
+        if (this != &other) {
+            destroy_inline();
+            heap_ = std::move(other.heap_);
+            on_heap_ = other.on_heap_;
+            if (!on_heap_) {
+                append_inline(std::make_move_iterator(other.inline_data()), other.size_);
+                other.destroy_inline();
+            }
+        }
+        return *this;
+    }
+
+    ~InlinePairStore() {
+        destroy_inline();
+    }
+
+    size_t size() const {
+        return on_heap_ ? heap_.size() : size_;
+    }
+
+    void reserve(size_t count) {
+        if (on_heap_) {
+            heap_.reserve(count);
+        } else if (count > N) {
+            move_to_heap(count);
+        }
+    }
+
+    void resize(size_t count) {
+        if (!on_heap_ && count <= N) {
+            truncate(count);
+            ElementAllocator allocator = heap_.get_allocator();
+            for (; size_ < count; size_++) {
+                Traits::construct(allocator, inline_data() + size_);
+            }
+            return;
+        }
+        reserve(count);
+        heap_.resize(count);
+    }
+
+    // The heap vector keeps its memory, as std::vector::clear does.
+    void clear() {
+        destroy_inline();
+        heap_.clear();
+    }
+
+    /* Returns elements into the inline buffer if they fit there. Elements, whose move may
+    throw, are copied, so if that throws, they all stay on the heap. Time: O(size). */
+    void shrink_to_fit() {
+        if (!on_heap_) {
+            return;
+        }
+        if (heap_.size() > N) {
+            heap_.shrink_to_fit();
+            return;
+        }
+        ElementAllocator allocator = heap_.get_allocator();
+        try {
+            for (; size_ < heap_.size(); size_++) {
+                Traits::construct(allocator, inline_data() + size_,
+                                  std::move_if_noexcept(heap_[size_]));
+            }
+        } catch (...) {
+            destroy_inline();
+            throw;
+        }
+        on_heap_ = false;
+        std::vector<Element, ElementAllocator>(heap_.get_allocator()).swap(heap_);
+    }
+
+    ElementAllocator get_allocator() const {
+        return heap_.get_allocator();
+    }
+
+    // The inline buffer is a part of the object, only the heap vector counts.
+    size_t allocated_bytes() const {
+        return heap_.capacity() * sizeof(Element);
+    }
+
+    const KeyType& key(size_t position) const {
+        return data()[position].first;
+    }
+
+    KeyType&& movable_key(size_t position) {
+        return std::move(data()[position].first);
+    }
+
+    ValueType& value(size_t position) {
+        return data()[position].second;
+    }
+
+    const ValueType& value(size_t position) const {
+        return data()[position].second;
+    }
+
+    reference element(size_t position) {
+        return {data()[position].first, data()[position].second};
+    }
+
+    const_reference element(size_t position) const {
+        return {data()[position].first, data()[position].second};
+    }
+
+    // Time: amortized O(1), O(N) for the move to the heap.
+    template<class Key, class... Args>
+    void emplace_back(Key&& key, Args&&... args) {
+        if (!on_heap_ && size_ < N) {
+            ElementAllocator allocator = heap_.get_allocator();
+            Traits::construct(allocator, inline_data() + size_, std::piecewise_construct,
+                              std::forward_as_tuple(std::forward<Key>(key)),
+                              std::forward_as_tuple(std::forward<Args>(args)...));
+            size_++;
+            return;
+        }
+        if (!on_heap_) {
+            emplace_moving_to_heap(std::forward<Key>(key), std::forward<Args>(args)...);
+            return;
+        }
+        heap_.emplace_back(std::piecewise_construct,
+                           std::forward_as_tuple(std::forward<Key>(key)),
+                           std::forward_as_tuple(std::forward<Args>(args)...));
+    }
+
+    template<class Key, class Value>
+    void assign(size_t position, Key&& key, Value&& value) {
+        data()[position].first = std::forward<Key>(key);
+        data()[position].second = std::forward<Value>(value);
+    }
+
+    // Time: O(1).
+    void swap_elements(size_t first, size_t second) {
+        std::swap(data()[first], data()[second]);
+    }
+
+    // Time: O(1).
+    void pop_back_into(size_t position) {
+        Element* elements = data();
+        size_t last = size() - 1;
+        if (position != last) {
+            elements[position] = std::move(elements[last]);
+        }
+        if (on_heap_) {
+            heap_.pop_back();
+        } else {
+            ElementAllocator allocator = heap_.get_allocator();
+            Traits::destroy(allocator, elements + last);
+            size_--;
+        }
+    }
+
+    // Time: O(1).
+    void move_into(size_t from, size_t to) {
+        data()[to] = std::move(data()[from]);
+    }
+
+    // Time: O(size - count).
+    void truncate(size_t count) {
+        if (on_heap_) {
+            heap_.erase(heap_.begin() + count, heap_.end());
+            return;
+        }
+        ElementAllocator allocator = heap_.get_allocator();
+        for (; size_ > count; size_--) {
+            Traits::destroy(allocator, inline_data() + size_ - 1);
+        }
+    }
+
+    IteratorRange<key_iterator> keys() const {
+        return {key_iterator(data()), key_iterator(data() + size())};
+    }
+
+    IteratorRange<value_iterator> values() {
+        return {value_iterator(data()), value_iterator(data() + size())};
+    }
+
+    IteratorRange<const_value_iterator> values() const {
+        return {const_value_iterator(data()), const_value_iterator(data() + size())};
+    }
+
+ private:
+    std::vector<Element, ElementAllocator> heap_;
+    alignas(Element) unsigned char buffer_[N * sizeof(Element)];
+    // Number of elements in buffer_, zero while they are on the heap.
+    size_t size_ = 0;
+    bool on_heap_ = false;
+
+    Element* inline_data() {
+        return std::launder(reinterpret_cast<Element*>(buffer_));
+    }
+
+    const Element* inline_data() const {
+        return std::launder(reinterpret_cast<const Element*>(buffer_));
+    }
+
+    Element* data() {
+        return on_heap_ ? heap_.data() : inline_data();
+    }
+
+    const Element* data() const {
+        return on_heap_ ? heap_.data() : inline_data();
+    }
+
+    /* Constructs count elements from source (copies them, or moves with move_iterator) at the
+    end of the inline buffer. The elements built so far are destroyed if one of them throws. */
+    template<class Iterator>
+    void append_inline(Iterator source, size_t count) {
+        ElementAllocator allocator = heap_.get_allocator();
+        try {
+            for (size_t i = 0; i < count; i++, ++source) {
+                Traits::construct(allocator, inline_data() + size_, *source);
+                size_++;
+            }
+        } catch (...) {
+            destroy_inline();
+            throw;
+        }
+    }
+
+    void destroy_inline() {
+        ElementAllocator allocator = heap_.get_allocator();
+        for (; size_ > 0; size_--) {
+            Traits::destroy(allocator, inline_data() + size_ - 1);
+        }
+    }
+
+    /* Moves inline elements into the heap vector with room for capacity elements. If a move
+    throws, the elements stay inline. Time: O(N). */
+    void move_to_heap(size_t capacity) {
+        heap_.clear();
+        heap_.reserve(std::max(capacity, size_));
+        try {
+            for (size_t i = 0; i < size_; i++) {
+                heap_.push_back(std::move_if_noexcept(inline_data()[i]));
+            }
+        } catch (...) {
+            heap_.clear();
+            throw;
+        }
+        destroy_inline();
+        on_heap_ = true;
+    }
+
+    /* Adds the element, that doesn't fit in the buffer. The arguments may refer to inline
+    elements (try_emplace(key, find(other)->second)), so the new element is constructed
+    before move_to_heap moves from them, and is moved to the heap after them. Time: O(N). */
+    template<class Key, class... Args>
+    void emplace_moving_to_heap(Key&& key, Args&&... args) {
+        ElementAllocator allocator = heap_.get_allocator();
+        alignas(Element) unsigned char storage[sizeof(Element)];
+        Element* element = reinterpret_cast<Element*>(storage);
+        Traits::construct(allocator, element, std::piecewise_construct,
+                          std::forward_as_tuple(std::forward<Key>(key)),
+                          std::forward_as_tuple(std::forward<Args>(args)...));
+        try {
+            move_to_heap(2 * N);
+            heap_.push_back(std::move(*element));
+        } catch (...) {
+            Traits::destroy(allocator, element);
+            throw;
+        }
+        Traits::destroy(allocator, element);
+    }
+};
+
+// Default storage policy: std::vector of pairs.
+struct PairStorage {
+    template<class KeyType, class ValueType, class Allocator>
+    using store = PairStore<KeyType, ValueType, Allocator>;
+};
+
+// Storage policy with separate arrays of keys and values (structure of arrays).
+struct SplitStorage {
+    template<class KeyType, class ValueType, class Allocator>
+    using store = SplitStore<KeyType, ValueType, Allocator>;
+};
+
+/* Storage policy for tiny tables: up to N pairs live inside HashMap, they are found by linear
+scan without hashing and no index is built. The table turns into usual hashed one (heap
+vector of pairs and the index) when it grows past N elements. */
+template<size_t N>
+struct InlineStorage {
+    template<class KeyType, class ValueType, class Allocator>
+    using store = InlinePairStore<KeyType, ValueType, Allocator, N>;
+};
+
+/* Snapshot file, that HashMap::save writes and MappedHashMap serves without deserialization.
+All numbers are in native byte order, all offsets are from the beginning of the file, so the
+file doesn't depend on the address where it is mapped:
+    SnapshotHeader;
+    bucket_count + 1 uint64_t offsets (CSR), elements of bucket b are offsets[b]..offsets[b+1]-1;
+    element_count keys and then element_count values, grouped by bucket.
+Arrays start at multiples of SNAPSHOT_ALIGNMENT. Buckets are FibonacciSizing buckets of the
+full hash, so the file must be opened with the same hash function. */
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t header_size;
+    uint64_t key_size;
+    uint64_t value_size;
+    uint64_t element_count;
+    uint64_t bucket_count;
+    uint64_t offsets_offset;
+    uint64_t keys_offset;
+    uint64_t values_offset;
+    uint64_t file_size;
+};
+
+constexpr char SNAPSHOT_MAGIC[8] = {'H', 'M', 'S', 'N', 'A', 'P', '\0', '\0'};
+constexpr uint32_t SNAPSHOT_VERSION = 1;
+constexpr uint64_t SNAPSHOT_ALIGNMENT = 64;
+
+// Rounds offset in the snapshot up to SNAPSHOT_ALIGNMENT. Time: O(1).
+inline uint64_t snapshot_align(uint64_t offset) {
+    return (offset + SNAPSHOT_ALIGNMENT - 1) / SNAPSHOT_ALIGNMENT * SNAPSHOT_ALIGNMENT;
+}
+
+#if __has_include(<sys/mman.h>)
+/* Read-only hash table over a snapshot file mapped into memory with mmap. Opening checks the
+header and maps the file, nothing is read or built, so it takes O(1) time and pages are read
+by the page cache on demand. find hashes the key once and scans one bucket of the key array.
+The file is trusted: the header is checked, but bucket offsets are not checked one by one.
+The object owns the mapping and can only be moved. */
+template<class KeyType, class ValueType, class Hash = std::hash<KeyType>,
+                            class KeyEqual = std::equal_to<KeyType>>
+class MappedHashMap {
+    static_assert(std::is_trivially_copyable<KeyType>::value &&
+                  std::is_trivially_copyable<ValueType>::value,
+                  "only trivially copyable keys and values can be mapped");
+
+ public:
+    /* Maps the snapshot file. Throws runtime_error if the file can't be mapped or was
+    written for other key or value types or by other version. Time: O(1). */
+    explicit MappedHashMap(const std::string& path, const Hash& hasher = Hash(),
+                           const KeyEqual& key_equal = KeyEqual()) :
+                        hasher_(hasher), key_equal_(key_equal) {
+        int file = ::open(path.c_str(), O_RDONLY);
+        if (file < 0) {
+            throw std::runtime_error("Can't open snapshot " + path);
+        }
+        struct stat file_stat;
+        if (::fstat(file, &file_stat) != 0 ||
+                static_cast<uint64_t>(file_stat.st_size) < sizeof(SnapshotHeader)) {
+            ::close(file);
+            throw std::runtime_error("Snapshot " + path + " is too short");
+        }
+        size_ = static_cast<size_t>(file_stat.st_size);
+        void* address = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, file, 0);
+        ::close(file);
+        if (address == MAP_FAILED) {
+            throw std::runtime_error("Can't map snapshot " + path);
+        }
+        data_ = static_cast<const char*>(address);
+        if (!valid()) {
+            ::munmap(const_cast<char*>(data_), size_);
+            throw std::runtime_error("Snapshot " + path + " has wrong format");
+        }
+        const SnapshotHeader& header = this->header();
+        sizing_.resize(header.bucket_count);
+        offsets_ = reinterpret_cast<const uint64_t*>(data_ + header.offsets_offset);
+        keys_ = reinterpret_cast<const KeyType*>(data_ + header.keys_offset);
+        values_ = reinterpret_cast<const ValueType*>(data_ + header.values_offset);
+    }
+
+    MappedHashMap(MappedHashMap&& other) noexcept :
+                        data_(other.data_), size_(other.size_), offsets_(other.offsets_),
+                        keys_(other.keys_), values_(other.values_), sizing_(other.sizing_),
+                        hasher_(other.hasher_), key_equal_(other.key_equal_) {
+        other.data_ = nullptr;
+    }
+
+    MappedHashMap(const MappedHashMap&) = delete;
+    MappedHashMap& operator=(const MappedHashMap&) = delete;
+    MappedHashMap& operator=(MappedHashMap&&) = delete;
+
+    ~MappedHashMap() {
+        if (data_ != nullptr) {
+            ::munmap(const_cast<char*>(data_), size_);
+        }
+    }
+
+    // Time: O(1).
+    size_t size() const {
+        return static_cast<size_t>(header().element_count);
+    }
+
+    // Time: O(1).
+    bool empty() const {
+        return size() == 0;
+    }
+
+    // Time: O(1).
+    size_t bucket_count() const {
+        return static_cast<size_t>(header().bucket_count);
+    }
+
+    // Returns pointer to the value of the key in the mapping or nullptr. Time: expected O(1).
+    const ValueType* find(const KeyType& key) const {
+        size_t bucket = sizing_.bucket(hasher_(key));
+        for (uint64_t i = offsets_[bucket]; i < offsets_[bucket + 1]; i++) {
+            if (key_equal_(keys_[i], key)) {
+                return &values_[i];
+            }
+        }
+        return nullptr;
+    }
+
+    // Time: expected O(1).
+    bool contains(const KeyType& key) const {
+        return find(key) != nullptr;
+    }
+
+    /* Returns reference to the value if this key is in the table.
+    Throws out_of_range exception otherwise. Time: expected O(1) */
+    const ValueType& at(const KeyType& key) const {
+        const ValueType* value = find(key);
+        if (value == nullptr) {
+            throw std::out_of_range("This element doesn't exist");
+        }
+        return *value;
+    }
+
+    // Contiguous ranges over all keys and all values, grouped by bucket. Time: O(1).
+    IteratorRange<const KeyType*> keys() const {
+        return {keys_, keys_ + size()};
+    }
+
+    IteratorRange<const ValueType*> values() const {
+        return {values_, values_ + size()};
+    }
+
+ private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    const uint64_t* offsets_ = nullptr;
+    const KeyType* keys_ = nullptr;
+    const ValueType* values_ = nullptr;
+    FibonacciSizing sizing_;
+    Hash hasher_;
+    KeyEqual key_equal_;
+
+    const SnapshotHeader& header() const {
+        return *reinterpret_cast<const SnapshotHeader*>(data_);
+    }
+
+    // Checks the header against the types and the file size. Time: O(1).
+    bool valid() const {
+        const SnapshotHeader& header = this->header();
+        uint64_t elements = header.element_count;
+        uint64_t buckets = header.bucket_count;
+        return std::equal(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 8, header.magic) &&
+               header.version == SNAPSHOT_VERSION &&
+               header.header_size == sizeof(SnapshotHeader) &&
+               header.key_size == sizeof(KeyType) && header.value_size == sizeof(ValueType) &&
+               alignof(KeyType) <= SNAPSHOT_ALIGNMENT && alignof(ValueType) <= SNAPSHOT_ALIGNMENT &&
+               buckets != 0 && (buckets & (buckets - 1)) == 0 &&
+               header.file_size == size_ &&
+               header.offsets_offset % SNAPSHOT_ALIGNMENT == 0 &&
+               header.keys_offset % SNAPSHOT_ALIGNMENT == 0 &&
+               header.values_offset % SNAPSHOT_ALIGNMENT == 0 &&
+               header.offsets_offset + (buckets + 1) * sizeof(uint64_t) <= header.keys_offset &&
+               header.keys_offset + elements * sizeof(KeyType) <= header.values_offset &&
+               header.values_offset + elements * sizeof(ValueType) <= size_ &&
+               reinterpret_cast<const uint64_t*>(data_ + header.offsets_offset)[buckets] ==
+                                                                                elements;
+    }
+};
+#endif
+
+/* Number of set bits. Without popcnt instruction __builtin_popcountll is a library call,
+so the bits are summed in parallel inside the word instead. Time: O(1). */
+inline size_t popcount64(uint64_t word) {
+#if defined(__GNUC__) && (defined(__POPCNT__) || defined(__aarch64__))
+    return static_cast<size_t>(__builtin_popcountll(word));
+#else
+    word -= (word >> 1) & UINT64_C(0x5555555555555555);
+    word = (word & UINT64_C(0x3333333333333333)) + ((word >> 2) & UINT64_C(0x3333333333333333));
+    word = (word + (word >> 4)) & UINT64_C(0x0F0F0F0F0F0F0F0F);
+    return static_cast<size_t>((word * UINT64_C(0x0101010101010101)) >> 56);
+#endif
+}
+
+/* Minimal perfect hash over a fixed set of hashes, BBHash style. Level 0 is a bit array of
+n bits, every hash sets the bit h0(hash) and the bits hit by two or more hashes are cleared;
+the hashes at the cleared bits go to level 1, that has as many bits as there are such hashes,
+and so on. A hash is the rank of its bit among all set bits, so slots are exactly 0..n-1. Bits
+take e = 2.72 bits per key and every block of 512 bits keeps the rank before it (one more
+eighth), about 3 bits per key in total. Hashes, that still collide after MAX_LEVELS_ levels (or
+equal hashes of different keys), get the last slots in the order of hash. */
+class MinimalPerfectHash {
+ public:
+    constexpr static size_t NPOS = static_cast<size_t>(-1);
+
+    MinimalPerfectHash() = default;
+
+    /* Builds the function for given hashes and writes slot of every hash into slots.
+    Time: expected O(quantity of hashes). */
+    MinimalPerfectHash(const std::vector<size_t>& hashes, std::vector<size_t>& slots) {
+        std::vector<size_t> remaining(hashes.size());
+        for (size_t i = 0; i < remaining.size(); i++) {
+            remaining[i] = i;
+        }
+        for (size_t level = 0; level < MAX_LEVELS_ && !remaining.empty(); level++) {
+            size_t words = (remaining.size() + 63) / 64;
+            size_t first_word = bits_.size();
+            level_begin_.push_back(first_word);
+            bits_.resize(first_word + words, 0);
+            std::vector<uint64_t> collisions(words, 0);
+            for (size_t i : remaining) {
+                size_t bit = position(hashes[i], level, words * 64);
+                uint64_t mask = static_cast<uint64_t>(1) << (bit % 64);
+                if (bits_[first_word + bit / 64] & mask) {
+                    collisions[bit / 64] |= mask;
+                }
+                bits_[first_word + bit / 64] |= mask;
+            }
+            std::vector<size_t> next;
+            for (size_t i : remaining) {
+                size_t bit = position(hashes[i], level, words * 64);
+                if (collisions[bit / 64] & (static_cast<uint64_t>(1) << (bit % 64))) {
+                    next.push_back(i);
+                }
+            }
+            for (size_t word = 0; word < words; word++) {
+                bits_[first_word + word] &= ~collisions[word];
+            }
+            remaining.swap(next);
+        }
+        level_begin_.push_back(bits_.size());
+        ranks_.resize(bits_.size() / WORDS_PER_RANK_ + 1);
+        size_t rank = 0;
+        for (size_t word = 0; word < bits_.size(); word++) {
+            if (word % WORDS_PER_RANK_ == 0) {
+                ranks_[word / WORDS_PER_RANK_] = rank;
+            }
+            rank += popcount64(bits_[word]);
+        }
+        placed_ = rank;
+
+        std::sort(remaining.begin(), remaining.end(), [&](size_t a, size_t b) {
+            return hashes[a] < hashes[b];
+        });
+        slots.assign(hashes.size(), 0);
+        for (size_t i = 0; i < hashes.size(); i++) {
+            slots[i] = find(hashes[i]);
+        }
+        for (size_t i = 0; i < remaining.size(); i++) {
+            slots[remaining[i]] = placed_ + i;
+            leftover_hashes_.push_back(hashes[remaining[i]]);
+        }
+    }
+
+    /* Returns the slot of the hash, if it was placed in levels, or NPOS. Hashes, that weren't
+    given to the constructor, get some slot too. Time: expected O(1). */
+    size_t find(size_t hash) const {
+        for (size_t level = 0; level + 1 < level_begin_.size(); level++) {
+            size_t bits = (level_begin_[level + 1] - level_begin_[level]) * 64;
+            size_t bit = level_begin_[level] * 64 + position(hash, level, bits);
+            uint64_t word = bits_[bit / 64];
+            uint64_t mask = static_cast<uint64_t>(1) << (bit % 64);
+            if (word & mask) {
+                return rank(bit / 64) + popcount64(word & (mask - 1));
+            }
+        }
+        return NPOS;
+    }
+
+    // First slot of hashes, that weren't placed in levels. Time: O(1).
+    size_t leftover_begin() const {
+        return placed_;
+    }
+
+    // The first leftover slot with the hash not less than given one. Time: O(log(leftovers)).
+    size_t leftover_lower_bound(size_t hash) const {
+        return placed_ + static_cast<size_t>(std::lower_bound(leftover_hashes_.begin(),
+                            leftover_hashes_.end(), hash) - leftover_hashes_.begin());
+    }
+
+    // Hash of the leftover slot. Time: O(1).
+    size_t leftover_hash(size_t slot) const {
+        return leftover_hashes_[slot - placed_];
+    }
+
+    // Memory of the function in bits. Time: O(1).
+    size_t bit_size() const {
+        return (bits_.size() + ranks_.size() + level_begin_.size() + leftover_hashes_.size()) * 64;
+    }
+
+ private:
+    constexpr static size_t MAX_LEVELS_ = 32;
+    constexpr static size_t WORDS_PER_RANK_ = 8;
+
+    std::vector<uint64_t> bits_;
+    // Rank before every WORDS_PER_RANK_ words of bits_.
+    std::vector<uint64_t> ranks_;
+    // First word of every level and the end of the last one.
+    std::vector<size_t> level_begin_;
+    std::vector<size_t> leftover_hashes_;
+    size_t placed_ = 0;
+
+    size_t rank(size_t word) const {
+        size_t result = ranks_[word / WORDS_PER_RANK_];
+        for (size_t i = word / WORDS_PER_RANK_ * WORDS_PER_RANK_; i < word; i++) {
+            result += popcount64(bits_[i]);
+        }
+        return result;
+    }
+
+    /* Independent uniform bit of the level for the hash (splitmix64 finalizer and fast range,
+    or a division without 128-bit integers). */
+    static size_t position(size_t hash, size_t level, size_t bits) {
+        uint64_t mixed = static_cast<uint64_t>(hash) + (level + 1) * UINT64_C(0x9E3779B97F4A7C15);
+        mixed = (mixed ^ (mixed >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+        mixed = (mixed ^ (mixed >> 27)) * UINT64_C(0x94D049BB133111EB);
+        mixed ^= mixed >> 31;
+#if defined(__SIZEOF_INT128__)
+        return static_cast<size_t>((static_cast<unsigned __int128>(mixed) * bits) >> 64);
+#else
+        return static_cast<size_t>(mixed % bits);
+#endif
+    }
+};
+
+/* Read-only hash table, that HashMap::freeze makes. Elements are permuted so that the element
+of a key lives in the slot given by MinimalPerfectHash of its hash: a lookup hashes the key once,
+tests a few bits (expected e levels, cache friendly) and then compares exactly one element, with
+no chains or probing. The index takes about 3 bits per key. */
+template<class KeyType, class ValueType, class Hash = std::hash<KeyType>,
+                            class KeyEqual = std::equal_to<KeyType>,
+                            class Allocator = std::allocator<std::pair<const KeyType, ValueType>>,
+                            class StoragePolicy = PairStorage>
+class FrozenHashMap {
+ public:
+    using Store = typename StoragePolicy::template store<KeyType, ValueType, Allocator>;
+
+    /* Takes elements already permuted by slots of the function. Usually it is called by
+    HashMap::freeze. Time: O(1). */
+    FrozenHashMap(Store&& store, MinimalPerfectHash&& function,
+                  const Hash& hasher = Hash(), const KeyEqual& key_equal = KeyEqual()) :
+                        store_(std::move(store)),
+                        function_(std::move(function)),
+                        hasher_(hasher),
+                        key_equal_(key_equal) {}
+
+    // Time: O(1).
+    size_t size() const {
+        return store_.size();
+    }
+
+    // Time: O(1).
+    bool empty() const {
+        return store_.size() == 0;
+    }
+
+    // Returns pointer to the value of the key or nullptr. Time: expected O(1).
+    const ValueType* find(const KeyType& key) const {
+        size_t position = find_position(key);
+        return position == store_.size() ? nullptr : &store_.value(position);
+    }
+
+    // Time: expected O(1).
+    bool contains(const KeyType& key) const {
+        return find_position(key) != store_.size();
+    }
+
+    // Returns number of elements with the key, that is 0 or 1. Time: expected O(1).
+    size_t count(const KeyType& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    /* Returns reference to the value if this key is in the table.
+    Throws out_of_range exception otherwise. Time: expected O(1) */
+    const ValueType& at(const KeyType& key) const {
+        size_t position = find_position(key);
+        if (position == store_.size()) {
+            throw std::out_of_range("This element doesn't exist");
+        }
+        return store_.value(position);
+    }
+
+    // Ranges over all keys and all values, in the order of slots. Time: O(1).
+    IteratorRange<typename Store::key_iterator> keys() const {
+        return store_.keys();
+    }
+
+    IteratorRange<typename Store::const_value_iterator> values() const {
+        return store_.values();
+    }
+
+    // Memory of the perfect hash function in bits. Time: O(1).
+    size_t index_bits() const {
+        return function_.bit_size();
+    }
+
+ private:
+    Store store_;
+    MinimalPerfectHash function_;
+    Hash hasher_;
+    KeyEqual key_equal_;
+
+    // Position of the key or size() if there is no such key. Time: expected O(1).
+    size_t find_position(const KeyType& key) const {
+        size_t hash = hasher_(key);
+        size_t slot = function_.find(hash);
+        if (slot != MinimalPerfectHash::NPOS) {
+            return key_equal_(store_.key(slot), key) ? slot : store_.size();
+        }
+        for (slot = function_.leftover_lower_bound(hash);
+                    slot < store_.size() && function_.leftover_hash(slot) == hash; slot++) {
+            if (key_equal_(store_.key(slot), key)) {
+                return slot;
+            }
+        }
+        return store_.size();
+    }
+};
+
+/* Snapshot of HashMap::stats(). Size, buckets, bytes and chain_histogram (chain_histogram[l] is
+the number of chains of length l in the units of max_chain_length) are filled for every table,
+counters of operations only with a stats policy that counts (CountingStats), they stay zero with
+NoStats. A lookup is every search by key: find, at, count, contains, operator[], inserts and
+erases by key. Its probes are the positions, whose cached hash or key was compared, so a miss in
+an empty bucket has 0 probes. Snapshots of several tables (shards) are summed with +=. */
+struct HashMapStats {
+    // Upper bounds of probe_histogram buckets, the last bucket (+Inf) has no bound.
+    constexpr static size_t PROBE_BOUNDS[] = {0, 1, 2, 4, 8, 16, 32};
+    constexpr static size_t PROBE_BUCKETS = 8;
+
+    size_t size = 0;
+    size_t bucket_count = 0;
+    // Heap bytes of value_store_, of the index and of cached hashes (not of what elements own).
+    size_t allocated_bytes = 0;
+    std::vector<size_t> chain_histogram;
+    uint64_t lookups = 0;
+    uint64_t hits = 0;
+    uint64_t probes = 0;
+    // probe_histogram[b] lookups took more than PROBE_BOUNDS[b - 1] and at most PROBE_BOUNDS[b].
+    uint64_t probe_histogram[PROBE_BUCKETS] = {};
+    // Rebuilds of the index (growth, shrink, rehash, reserve) and their total time.
+    uint64_t rehashes = 0;
+    uint64_t rehash_nanoseconds = 0;
+
+    // Bucket of probe_histogram for the number of probes. Time: O(log probes).
+    static size_t probe_bucket(size_t probes) {
+        return (probes == 0) ? 0 : std::min(bit_length(probes - 1) + 1, PROBE_BUCKETS - 1);
+    }
+
+    // Time: O(1).
+    uint64_t misses() const {
+        return lookups - hits;
+    }
+
+    // Share of lookups, that found the key, 0 without lookups. Time: O(1).
+    double hit_ratio() const {
+        return (lookups == 0) ? 0 : static_cast<double>(hits) / lookups;
+    }
+
+    // Adds up snapshots of two tables. Time: O(length of the histograms).
+    HashMapStats& operator+=(const HashMapStats& other) {
+        size += other.size;
+        bucket_count += other.bucket_count;
+        allocated_bytes += other.allocated_bytes;
+        if (chain_histogram.size() < other.chain_histogram.size()) {
+            chain_histogram.resize(other.chain_histogram.size());
+        }
+        for (size_t i = 0; i < other.chain_histogram.size(); i++) {
+            chain_histogram[i] += other.chain_histogram[i];
+        }
+        lookups += other.lookups;
+        hits += other.hits;
+        probes += other.probes;
+        for (size_t i = 0; i < PROBE_BUCKETS; i++) {
+            probe_histogram[i] += other.probe_histogram[i];
+        }
+        rehashes += other.rehashes;
+        rehash_nanoseconds += other.rehash_nanoseconds;
+        return *this;
+    }
+
+    /* The snapshot in Prometheus text exposition format, every metric name starts with name:
+    counters name_lookups_total, name_hits_total, name_misses_total, name_rehashes_total,
+    name_rehash_seconds_total, histograms name_lookup_probes and name_chain_length, gauges
+    name_size, name_bucket_count and name_allocated_bytes. Time: O(length of the histograms). */
+    std::string prometheus(const std::string& name) const {
+        std::string text;
+        auto metric = [&](const std::string& suffix, const char* type, const std::string& value) {
+            text += "# TYPE " + name + suffix + " " + type + "\n";
+            text += name + suffix + " " + value + "\n";
+        };
+        auto histogram = [&](const std::string& suffix, const std::vector<uint64_t>& counts,
+                             const std::vector<std::string>& bounds, uint64_t sum) {
+            text += "# TYPE " + name + suffix + " histogram\n";
+            uint64_t count = 0;
+            for (size_t i = 0; i < counts.size(); i++) {
+                count += counts[i];
+                text += name + suffix + "_bucket{le=\"" + bounds[i] + "\"} " +
+                                    std::to_string(count) + "\n";
+            }
+            text += name + suffix + "_sum " + std::to_string(sum) + "\n";
+            text += name + suffix + "_count " + std::to_string(count) + "\n";
+        };
+        metric("_lookups_total", "counter", std::to_string(lookups));
+        metric("_hits_total", "counter", std::to_string(hits));
+        metric("_misses_total", "counter", std::to_string(misses()));
+        std::vector<std::string> bounds;
+        for (size_t bound : PROBE_BOUNDS) {
+            bounds.push_back(std::to_string(bound));
+        }
+        bounds.push_back("+Inf");
+        histogram("_lookup_probes", std::vector<uint64_t>(probe_histogram,
+                                                          probe_histogram + PROBE_BUCKETS),
+                  bounds, probes);
+        metric("_rehashes_total", "counter", std::to_string(rehashes));
+        metric("_rehash_seconds_total", "counter", std::to_string(rehash_nanoseconds * 1e-9));
+        std::vector<uint64_t> chains(chain_histogram.begin(), chain_histogram.end());
+        bounds.clear();
+        uint64_t total_length = 0;
+        for (size_t length = 0; length < chains.size(); length++) {
+            bounds.push_back(std::to_string(length));
+            total_length += length * chains[length];
+        }
+        chains.push_back(0);
+        bounds.push_back("+Inf");
+        histogram("_chain_length", chains, bounds, total_length);
+        metric("_size", "gauge", std::to_string(size));
+        metric("_bucket_count", "gauge", std::to_string(bucket_count));
+        metric("_allocated_bytes", "gauge", std::to_string(allocated_bytes));
+        return text;
+    }
+};
+
+/* Stats policies. HashMap calls its stats policy on the hot paths:
+    ENABLED                 false if the hooks are empty, then HashMap doesn't count probes
+                            or read the clock at all;
+    lookup(probes, hit)     after every lookup by key (see HashMapStats);
+    rehash(nanoseconds)     after every rebuild of the index;
+    snapshot(stats)         fills the counters of HashMapStats;
+    reset()                 sets the counters to zero.
+The policy is a mutable member: constant lookups may run in parallel (ConcurrentHashMap
+readers, ReadMostlyHashMap), so lookup must be thread safe. */
+
+// Default stats policy: nothing is counted, the hooks are compiled out.
+struct NoStats {
+    constexpr static bool ENABLED = false;
+
+    void lookup(size_t, bool) {}
+
+    void rehash(uint64_t) {}
+
+    void snapshot(HashMapStats&) const {}
+
+    void reset() {}
+};
+
+/* Counts lookups, hits, probes with a histogram of probes per lookup, rehashes and their time.
+Counters are relaxed atomics, so parallel constant lookups count correctly, a lookup costs two
+or three atomic increments. Copies of the table copy current counters. */
+class CountingStats {
+ public:
+    constexpr static bool ENABLED = true;
+
+    CountingStats() = default;
+
+    CountingStats(const CountingStats& other) noexcept {
+        *this = other;
+    }
+
+    CountingStats& operator=(const CountingStats& other) noexcept {
+        copy(hits_, other.hits_);
+        copy(probes_, other.probes_);
+        for (size_t i = 0; i < HashMapStats::PROBE_BUCKETS; i++) {
+            copy(probe_histogram_[i], other.probe_histogram_[i]);
+        }
+        copy(rehashes_, other.rehashes_);
+        copy(rehash_nanoseconds_, other.rehash_nanoseconds_);
+        return *this;
+    }
+
+    // Time: O(log probes).
+    void lookup(size_t probes, bool hit) {
+        if (hit) {
+            hits_.fetch_add(1, std::memory_order_relaxed);
+        }
+        probes_.fetch_add(probes, std::memory_order_relaxed);
+        probe_histogram_[HashMapStats::probe_bucket(probes)].fetch_add(1,
+                                                            std::memory_order_relaxed);
+    }
+
+    // Time: O(1).
+    void rehash(uint64_t nanoseconds) {
+        rehashes_.fetch_add(1, std::memory_order_relaxed);
+        rehash_nanoseconds_.fetch_add(nanoseconds, std::memory_order_relaxed);
+    }
+
+    // Time: O(1).
+    void snapshot(HashMapStats& stats) const {
+        stats.hits = hits_.load(std::memory_order_relaxed);
+        stats.probes = probes_.load(std::memory_order_relaxed);
+        stats.lookups = 0;
+        for (size_t i = 0; i < HashMapStats::PROBE_BUCKETS; i++) {
+            stats.probe_histogram[i] = probe_histogram_[i].load(std::memory_order_relaxed);
+            stats.lookups += stats.probe_histogram[i];
+        }
+        stats.rehashes = rehashes_.load(std::memory_order_relaxed);
+        stats.rehash_nanoseconds = rehash_nanoseconds_.load(std::memory_order_relaxed);
+    }
+
+    // Time: O(1).
+    void reset() {
+        *this = CountingStats();
+    }
+
+ private:
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> probes_{0};
+    // Every lookup is in one bucket of the histogram, so it is also the counter of lookups.
+    std::atomic<uint64_t> probe_histogram_[HashMapStats::PROBE_BUCKETS] = {};
+    std::atomic<uint64_t> rehashes_{0};
+    std::atomic<uint64_t> rehash_nanoseconds_{0};
+
+    static void copy(std::atomic<uint64_t>& to, const std::atomic<uint64_t>& from) {
+        to.store(from.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    }
+};
+
+/* Element taken out of HashMap by extract. insert(node_type&&) puts it into any HashMap with
+the same key and value types, whatever its other policies are. Elements live by value in the
+dense value_store_, so there is no node to relink: the key and the value are moved into the
+node and then moved into the other table, they are never copied. An empty node is default
+constructed or left after a successful insert. */
+template<class KeyType, class ValueType>
+class HashMapNode {
+ public:
+    using key_type = KeyType;
+    using mapped_type = ValueType;
+
+    HashMapNode() = default;
+
+    // Time: O(1).
+    bool empty() const noexcept {
+        return !element_.has_value();
+    }
+
+    explicit operator bool() const noexcept {
+        return element_.has_value();
+    }
+
+    // Key of non-empty node, it may be changed before insert. Time: O(1).
+    KeyType& key() {
+        return element_->first;
+    }
+
+    const KeyType& key() const {
+        return element_->first;
+    }
+
+    // Value of non-empty node. Time: O(1).
+    ValueType& mapped() {
+        return element_->second;
+    }
+
+    const ValueType& mapped() const {
+        return element_->second;
+    }
+
+ private:
+    /* Only extract fills nodes, there is no constructor from a key and a value, so
+    insert({key, value}) is never taken for insert of a node. */
+    template<class, class, class, class, class, class, bool, class, class>
+    friend class HashMap;
+
+    std::optional<std::pair<KeyType, ValueType>> element_;
+};
+
+/* This class implements algorithm that is known as Hash Table.
+By default I use implementation with separate chaining using std::vector (ChainedIndex),
+flat open addressing (OpenAddressingIndex) or Swiss table style group probing
+(GroupProbingIndex) can be chosen with IndexPolicy parameter. Keys are compared with KeyEqual,
+Allocator is used for value_store_ and for the index (PmrHashMap takes std::pmr resource). Every index takes a bucket sizing
+policy, for example OpenAddressingIndex<PowerOfTwoSizing>. IncrementalChainedIndex spreads
+rehash over following operations instead of doing it in one insert. With CacheHash = true the full
+hash of every element is kept in hash_store_ next to value_store_, so growth and erase never
+call the hash function again and keys are compared only when their hashes are equal.
+StoragePolicy chooses layout of value_store_: pairs (PairStorage) or separate arrays of keys and
+values (SplitStorage). With both layouts iterators return pair-like ElementReference by value, so
+loops over the table take elements as auto&& or const auto&, not auto&. New table allocates
+nothing, the index is built by the first insert. With InlineStorage<N> up to N elements live
+inside the object and are found by linear scan without hashing, the index appears only when
+the table grows past N elements. StatsPolicy = CountingStats counts lookups, probes and rehashes
+for stats(), the default NoStats compiles the counting out. HashMapPolicies bundles all policies
+with a threading one (ConcurrentHashMap, ReadMostlyHashMap) for ConfiguredHashMap.
+Moves of the table are O(1) and noexcept (unless the hash, the comparator or a stateful
+allocator may throw), so std::vector of tables moves them on reallocation. extract, insert of
+nodes and merge move elements between tables with any policies without copying them.
+merge_with, union_with, intersect and difference combine tables in place in one pass.
+Table doubles its size when the number of elements becomes more than max_load_factor()
+ of hash table capacity (2/3 by default, it can be changed at runtime), and with min_load_factor()
+ set it shrinks back after erases. Linear iteration is provided with two tables idea. The first one (hashed_pointers_)
+is a hash table and there I just keep indices of real data contained in the second table (value_store_)
+. Quantity of elements is equal to the size of the second table. Iterators know nothing about first hash 
+table. First table exists only for the fast search of elements but not for iteration. 
+
+You can read about it more using following link: https://en.wikipedia.org/wiki/Hash_table
+*/
+
+template<class KeyType, class ValueType, class Hash = std::hash<KeyType>,
+                            class KeyEqual = std::equal_to<KeyType>,
+                            class Allocator = std::allocator<std::pair<const KeyType, ValueType>>,
+                            class IndexPolicy = ChainedIndex<>,
+                            bool CacheHash = false,
+                            class StoragePolicy = PairStorage,
+                            class StatsPolicy = NoStats>
+class HashMap {
+    // Storage of elements, chosen by StoragePolicy.
+    using Store = typename StoragePolicy::template store<KeyType, ValueType, Allocator>;
+
+    // Tables with other policies, merge moves elements out of them.
+    template<class, class, class, class, class, class, bool, class, class>
+    friend class HashMap;
+
+ public:
+    using allocator_type = Allocator;
+    using node_type = HashMapNode<KeyType, ValueType>;
+
+    /* This method creates empty hash table. All memory of the table (elements, index and
+    cached hashes) is taken from the allocator. Time: O(1). */
+    HashMap(const Hash& hasher = Hash(), const KeyEqual& key_equal = KeyEqual(),
+            const Allocator& allocator = Allocator()) :
+                        value_store_(allocator),
+                        hash_store_(IndexAllocator(allocator)),
+                        hashed_pointers_(IndexAllocator(allocator)),
+                        hasher_(hasher),
+                        key_equal_(key_equal) {}
+
+    // Empty hash table that takes memory from the allocator. Time: O(1).
+    explicit HashMap(const Allocator& allocator) :
+                        HashMap(Hash(), KeyEqual(), allocator) {}
+
+    // Time: O(quantity of elements in the table + bucket_count).
+    HashMap(const HashMap&) = default;
+
+    /* Takes the elements, the index and cached hashes of other, nothing is copied or hashed
+    again. Other is left empty and without buckets. Time: O(1), O(INLINE_CAPACITY) inline. */
+    HashMap(HashMap&& other) noexcept(NOTHROW_MOVE_CONSTRUCTIBLE_) :
+                        value_store_(std::move(other.value_store_)),
+                        hash_store_(std::move(other.hash_store_)),
+                        hashed_pointers_(std::move(other.hashed_pointers_)),
+                        hasher_(std::move(other.hasher_)),
+                        key_equal_(std::move(other.key_equal_)),
+                        max_load_factor_(other.max_load_factor_),
+                        min_load_factor_(other.min_load_factor_),
+                        stats_(other.stats_) {
+        other.clear();
+    }
+
+    // Time: O(quantity of elements in both tables + bucket_count).
+    HashMap& operator=(const HashMap&) = default;
+
+    /* The same as the move constructor. With an allocator, that is not propagated and is not
+    equal, elements are moved one by one. Time: O(1) otherwise. */
+    HashMap& operator=(HashMap&& other) noexcept(NOTHROW_MOVE_ASSIGNABLE_) {
+        if (this != &other) {
+            value_store_ = std::move(other.value_store_);
+            hash_store_ = std::move(other.hash_store_);
+            hashed_pointers_ = std::move(other.hashed_pointers_);
+            hasher_ = std::move(other.hasher_);
+            key_equal_ = std::move(other.key_equal_);
+            max_load_factor_ = other.max_load_factor_;
+            min_load_factor_ = other.min_load_factor_;
+            stats_ = other.stats_;
+            other.clear();
+        }
+        return *this;
+    }
+
+    // Exchanges contents with other, allocators must be equal unless they propagate. Time: O(1).
+    void swap(HashMap& other) noexcept(NOTHROW_MOVE_CONSTRUCTIBLE_ && NOTHROW_MOVE_ASSIGNABLE_) {
+        using std::swap;
+        swap(value_store_, other.value_store_);
+        swap(hash_store_, other.hash_store_);
+        swap(hashed_pointers_, other.hashed_pointers_);
+        swap(hasher_, other.hasher_);
+        swap(key_equal_, other.key_equal_);
+        swap(max_load_factor_, other.max_load_factor_);
+        swap(min_load_factor_, other.min_load_factor_);
+        swap(stats_, other.stats_);
+    }
+
+    /* This method creates hash table using elements between two given forward iterators (these iterators are
+    not connected with HashMap class, they can be iterators of any other class). For forward iterators
+    the table is sized once for std::distance(first, last) elements, so it never grows while building.
+    Time: O(quantity of elements in table). */
+    template<class Forward_Iter>
+    HashMap(Forward_Iter first, Forward_Iter last,
+                    const Hash& hasher = Hash(),
+                    const KeyEqual& key_equal = KeyEqual(),
+                    const Allocator& allocator = Allocator()) :
+                        HashMap(hasher, key_equal, allocator) {
+        if (IsMultiPass<Forward_Iter>::value) {
+            reserve(std::distance(first, last));
+        }
+        for (; first != last; first++) {
+            insert(*first);
+        }
+    }
+
+    /* This method creates hash table using elements in initializer list.
+    Time: O(quantity of elements in table). */
+    HashMap(std::initializer_list<std::pair<KeyType, ValueType>>
+                        init_list, const Hash& hasher = Hash(),
+                        const KeyEqual& key_equal = KeyEqual(),
+                        const Allocator& allocator = Allocator()) :
+                                HashMap(hasher, key_equal, allocator)  {
+        reserve(init_list.size());
+        for (const auto& elem : init_list) {
+            insert(elem);
+        }
+    }
+
+    /* This is random access iterator class. It helps to iterate in the data structure.
+    Iterators work only with storage of real data and don't know about hash_table with
+    indices. Iterators became invalid after inserting and erasing elements. It is better
+    to use iterators than pointers. Dereference gives ElementReference (members first and
+    second) by value, there are no std::pair objects with constant keys in storage. Forward
+    iterators must return value_type&, so iterator_category is input, and iterator_concept
+    tells C++20 ranges and algorithms that it is random access. IsConst = true gives
+    const_iterator, iterator converts to it. Each method works in O(1) time. */
+    template<bool IsConst>
+    class Iterator {
+        friend class HashMap;
+        using Owner = typename std::conditional<IsConst, const HashMap, HashMap>::type;
+
+     public:
+        using value_type = std::pair<KeyType, ValueType>;
+        using reference = typename std::conditional<IsConst, typename Store::const_reference,
+                                                    typename Store::reference>::type;
+        using pointer = ArrowProxy<reference>;
+        using difference_type = std::ptrdiff_t;
+        using iterator_category = std::input_iterator_tag;
+        using iterator_concept = std::random_access_iterator_tag;
+
+        // Iterator constructor.
+        Iterator(size_t index = 0, Owner* my_hashmap = nullptr) :
+            index_(index), my_hashmap_(my_hashmap) {}
+
+        // Constant iterator from usual one.
+        template<bool OtherConst, class = typename std::enable_if<IsConst && !OtherConst>::type>
+        Iterator(const Iterator<OtherConst>& other) :
+            index_(other.index_), my_hashmap_(other.my_hashmap_) {}
+
+        reference operator*() const {
+            return my_hashmap_->value_store_.element(index_);
+        }
+
+        pointer operator->() const {
+            return pointer(**this);
+        }
+
+        reference operator[](difference_type n) const {
+            return my_hashmap_->value_store_.element(index_ + n);
+        }
+
+        Iterator& operator++() {
+            index_++;
+            return (*this);
+        }
+
+        Iterator operator++(int) {
+            Iterator copied = (*this);
+            index_++;
+            return copied;
+        }
+
+        Iterator& operator--() {
+            index_--;
+            return (*this);
+        }
+
+        Iterator operator--(int) {
+            Iterator copied = (*this);
+            index_--;
+            return copied;
+        }
+
+        Iterator& operator+=(difference_type n) {
+            index_ += n;
+            return (*this);
+        }
+
+        Iterator& operator-=(difference_type n) {
+            index_ -= n;
+            return (*this);
+        }
+
+        Iterator operator+(difference_type n) const {
+            return {index_ + n, my_hashmap_};
+        }
+
+        friend Iterator operator+(difference_type n, const Iterator& iter) {
+            return iter + n;
+        }
+
+        Iterator operator-(difference_type n) const {
+            return {index_ - n, my_hashmap_};
+        }
+
+        difference_type operator-(const Iterator& other) const {
+            return static_cast<difference_type>(index_) -
+                   static_cast<difference_type>(other.index_);
+        }
+
+        bool operator ==(const Iterator& other) const {
+            return ((index_ == other.index_)
+                    && (my_hashmap_ == other.my_hashmap_));
+        }
+
+        bool operator !=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+        bool operator <(const Iterator& other) const {
+            return index_ < other.index_;
+        }
+
+        bool operator >(const Iterator& other) const {
+            return other < *this;
+        }
+
+        bool operator <=(const Iterator& other) const {
+            return !(other < *this);
+        }
+
+        bool operator >=(const Iterator& other) const {
+            return !(*this < other);
+        }
+
+        size_t index() const {
+            return index_;
+        }
+
+     private:
+        size_t index_;
+        Owner* my_hashmap_ = nullptr;
+
+        friend class Iterator<!IsConst>;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+    // Time: O(1).
+    const size_t size() const {
+        return value_store_.size();
+    }
+
+    // Time: O(1). 
+    const bool empty() const {
+        return value_store_.size() == 0;
+    }
+
+    // Returns number of buckets of the index. Time: O(1).
+    size_t bucket_count() const {
+        return hashed_pointers_.bucket_count();
+    }
+
+    /* Length of the longest chain of the index, that a lookup may walk: bucket for chained
+    indices, cluster of cells for OpenAddressingIndex, probed groups for GroupProbingIndex
+    (the whole table in the linear mode). Time: O(bucket_count). */
+    size_t max_chain_length() const {
+        return indexed() ? hashed_pointers_.max_chain_length() : value_store_.size();
+    }
+
+    /* True if the longest chain is far longer than a good hash function gives for this
+    size and load, so lookups are slow because of the hash (identity hash of sequential ids
+    or aligned pointers with power of two buckets, for example). WyHash or MixedHash from
+    hash_functions.h fix that. With HASH_MAP_DEBUG defined every growth checks it and writes
+    a warning to stderr once. Time: O(bucket_count). */
+    bool skewed() const {
+        return indexed() && hashed_pointers_.max_chain_length() >
+                                hashed_pointers_.skew_limit(value_store_.size());
+    }
+
+    /* Snapshot of the table for monitoring (see HashMapStats), HashMapStats::prometheus
+    formats it for Prometheus. Time: O(bucket_count). */
+    HashMapStats stats() const {
+        HashMapStats result;
+        result.size = value_store_.size();
+        result.bucket_count = hashed_pointers_.bucket_count();
+        result.allocated_bytes = value_store_.allocated_bytes() +
+                    hash_store_.capacity() * sizeof(size_t) + hashed_pointers_.allocated_bytes();
+        hashed_pointers_.for_each_chain([&result](size_t length) {
+            if (length >= result.chain_histogram.size()) {
+                result.chain_histogram.resize(length + 1);
+            }
+            result.chain_histogram[length]++;
+        });
+        stats_.snapshot(result);
+        return result;
+    }
+
+    // Sets counters of the stats policy to zero. Time: O(1).
+    void reset_stats() {
+        stats_.reset();
+    }
+
+    // Average number of elements per bucket, the linear mode counts as one bucket. Time: O(1).
+    float load_factor() const {
+        return static_cast<float>(value_store_.size()) /
+                    std::max<size_t>(hashed_pointers_.bucket_count(), 1);
+    }
+
+    // Load factor, above which the table grows. Time: O(1).
+    float max_load_factor() const {
+        return max_load_factor_;
+    }
+
+    /* Sets load factor, above which the table grows. It is clamped to LOAD_FACTOR_LIMIT of
+    the index (below 1 for open addressing) and the table is rebuilt at once if it is
+    already more loaded. Time: O(1), O(quantity of elements in the table) for the rebuild. */
+    void max_load_factor(float load_factor) {
+        max_load_factor_ = std::min(std::max(load_factor, MIN_LOAD_FACTOR_),
+                                    Index::LOAD_FACTOR_LIMIT);
+        min_load_factor_ = std::min(min_load_factor_, max_load_factor_ / HYSTERESIS_);
+        if (indexed() &&
+                    value_store_.size() >= hashed_pointers_.bucket_count() * max_load_factor_) {
+            rehash(0);
+        }
+    }
+
+    // Load factor, below which erase shrinks the table, 0 means never. Time: O(1).
+    float min_load_factor() const {
+        return min_load_factor_;
+    }
+
+    /* Turns on automatic shrink: when erase makes load factor less than load_factor,
+    the index is rebuilt with half of max_load_factor() load and value_store_ gives its
+    spare memory back. The value is clamped to max_load_factor() / 4, so after any rebuild
+    many inserts or erases are needed before the next one. Time: O(1). */
+    void min_load_factor(float load_factor) {
+        min_load_factor_ = std::min(std::max(load_factor, 0.0f), max_load_factor_ / HYSTERESIS_);
+    }
+
+    /* Prepares the table for count elements: the storage is reserved and the index
+    gets enough buckets, so the next inserts up to count elements don't rebuild it.
+    Time: O(quantity of elements in the table + count). */
+    void reserve(size_t count) {
+        value_store_.reserve(count);
+        if (count <= Store::INLINE_CAPACITY) {
+            return;
+        }
+        if (CacheHash) {
+            hash_store_.reserve(count);
+        }
+        size_t needed = min_bucket_count(count);
+        if (needed > hashed_pointers_.bucket_count()) {
+            build_index(needed);
+        }
+    }
+
+    /* Rebuilds the index with at least bucket_count buckets, but not less than needed
+    for the current size. Time: O(quantity of elements in the table + bucket_count). */
+    void rehash(size_t bucket_count) {
+        build_index(std::max(bucket_count, min_bucket_count(value_store_.size())));
+    }
+
+    /* The same as rehash, but hashes are computed in parallel on the executor (unless they
+    are cached) and chained indices fill ranges of buckets in parallel too.
+    Time: O(quantity of elements in the table + bucket_count) work. */
+    template<class Executor = ThreadExecutor>
+    void rehash_parallel(size_t bucket_count, Executor executor = Executor()) {
+        size_t elements = value_store_.size();
+        bucket_count = std::max(bucket_count, min_bucket_count(elements));
+        if (CacheHash) {
+            fill_hash_store();
+            timed_rebuild([&] {
+                hashed_pointers_.parallel_rebuild(bucket_count, elements, position_hasher(),
+                                                  executor);
+            });
+            return;
+        }
+        std::vector<size_t> hashes(elements);
+        size_t chunks = parallel_chunk_count(executor, elements);
+        executor(chunks, [&](size_t chunk) {
+            for (size_t i = chunk_begin(elements, chunks, chunk);
+                                i < chunk_begin(elements, chunks, chunk + 1); i++) {
+                hashes[i] = hasher_(value_store_.key(i));
+            }
+        });
+        timed_rebuild([&] {
+            hashed_pointers_.parallel_rebuild(bucket_count, elements,
+                        [&](size_t position) { return hashes[position]; }, executor);
+        });
+    }
+
+    /* Builds hash table from elements between two random access iterators on all threads of
+    the executor. Keys are hashed in parallel chunks, then radix partitioned by hash, so equal
+    keys meet in one part and every part drops duplicates independently (the earliest element
+    wins, as with insert). Parts are copied into value_store_ in parallel (if the elements are
+    default constructible) and the index is filled by parallel_rebuild, unless the distinct
+    keys fit Store::INLINE_CAPACITY and the table stays in the linear mode. The allocator must
+    be thread safe. Time: O(quantity of elements * log) work, spread over the executor. */
+    template<class RandomIt, class Executor = ThreadExecutor>
+    static HashMap build_parallel(RandomIt first, RandomIt last, Executor executor = Executor(),
+                                  const Hash& hasher = Hash(),
+                                  const KeyEqual& key_equal = KeyEqual(),
+                                  const Allocator& allocator = Allocator()) {
+        HashMap result(hasher, key_equal, allocator);
+        size_t count = static_cast<size_t>(last - first);
+        size_t parts = parallel_chunk_count(executor, count);
+        std::vector<size_t> hashes(count);
+        executor(parts, [&](size_t chunk) {
+            for (size_t i = chunk_begin(count, parts, chunk);
+                                i < chunk_begin(count, parts, chunk + 1); i++) {
+                hashes[i] = result.hasher_(first[i].first);
+            }
+        });
+        auto part_of = [&](size_t i) {
+            uint64_t mixed = static_cast<uint64_t>(hashes[i]) * UINT64_C(11400714819323198485);
+            return static_cast<size_t>(((mixed >> 32) * parts) >> 32);
+        };
+        auto partition = radix_partition(count, parts, part_of, executor);
+        std::vector<size_t>& order = partition.first;
+        std::vector<size_t>& part_begin = partition.second;
+
+        // Inside a part equal keys have equal hashes, so after sort they are neighbours.
+        std::vector<char> keep(count, 0);
+        std::vector<size_t> kept(parts + 1, 0);
+        executor(parts, [&](size_t part) {
+            auto begin = order.begin() + part_begin[part];
+            auto end = order.begin() + part_begin[part + 1];
+            std::sort(begin, end, [&](size_t a, size_t b) {
+                return hashes[a] < hashes[b] || (hashes[a] == hashes[b] && a < b);
+            });
+            for (auto run = begin; run != end;) {
+                auto run_end = run;
+                while (run_end != end && hashes[*run_end] == hashes[*run]) {
+                    run_end++;
+                }
+                for (auto i = run; i != run_end; i++) {
+                    bool duplicate = false;
+                    for (auto j = run; j != i && !duplicate; j++) {
+                        duplicate = keep[*j] &&
+                                result.key_equal_(first[*j].first, first[*i].first);
+                    }
+                    keep[*i] = !duplicate;
+                    kept[part + 1] += keep[*i];
+                }
+                run = run_end;
+            }
+        });
+        for (size_t part = 0; part < parts; part++) {
+            kept[part + 1] += kept[part];
+        }
+        size_t elements = kept[parts];
+
+        std::vector<size_t> store_hashes(elements);
+        if constexpr (std::is_default_constructible<KeyType>::value &&
+                      std::is_default_constructible<ValueType>::value) {
+            result.value_store_.resize(elements);
+            executor(parts, [&](size_t part) {
+                size_t position = kept[part];
+                for (size_t i = part_begin[part]; i < part_begin[part + 1]; i++) {
+                    if (keep[order[i]]) {
+                        result.value_store_.assign(position, first[order[i]].first,
+                                                   first[order[i]].second);
+                        store_hashes[position] = hashes[order[i]];
+                        position++;
+                    }
+                }
+            });
+        } else {
+            result.value_store_.reserve(elements);
+            for (size_t i = 0; i < count; i++) {
+                if (keep[order[i]]) {
+                    store_hashes[result.value_store_.size()] = hashes[order[i]];
+                    result.value_store_.emplace_back(first[order[i]].first,
+                                                     first[order[i]].second);
+                }
+            }
+        }
+        if (elements <= Store::INLINE_CAPACITY) {
+            return result;
+        }
+        result.timed_rebuild([&] {
+            result.hashed_pointers_.parallel_rebuild(result.min_bucket_count(elements), elements,
+                        [&](size_t position) { return store_hashes[position]; }, executor);
+        });
+        if (CacheHash) {
+            result.hash_store_.assign(store_hashes.begin(), store_hashes.end());
+        }
+        return result;
+    }
+
+    /* Writes the table into snapshot file (format is described at SnapshotHeader), that
+    open_mmap maps back without reading it. Only for trivially copyable keys and values.
+    Throws runtime_error if the file can't be written.
+    Time: O(quantity of elements in the table + bucket_count). */
+    void save(const std::string& path) const {
+        static_assert(std::is_trivially_copyable<KeyType>::value &&
+                      std::is_trivially_copyable<ValueType>::value,
+                      "only trivially copyable keys and values can be saved");
+        size_t elements = value_store_.size();
+        size_t buckets = FibonacciSizing::round(min_bucket_count(elements));
+        FibonacciSizing sizing;
+        sizing.resize(buckets);
+        std::vector<size_t> element_bucket(elements);
+        std::vector<uint64_t> offsets(buckets + 1, 0);
+        for (size_t i = 0; i < elements; i++) {
+            element_bucket[i] = sizing.bucket(position_hash(i));
+            offsets[element_bucket[i] + 1]++;
+        }
+        for (size_t bucket = 0; bucket < buckets; bucket++) {
+            offsets[bucket + 1] += offsets[bucket];
+        }
+        std::vector<size_t> order(elements);
+        std::vector<uint64_t> next(offsets.begin(), offsets.end() - 1);
+        for (size_t i = 0; i < elements; i++) {
+            order[next[element_bucket[i]]++] = i;
+        }
+
+        SnapshotHeader header{};
+        std::copy(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 8, header.magic);
+        header.version = SNAPSHOT_VERSION;
+        header.header_size = sizeof(SnapshotHeader);
+        header.key_size = sizeof(KeyType);
+        header.value_size = sizeof(ValueType);
+        header.element_count = elements;
+        header.bucket_count = buckets;
+        header.offsets_offset = snapshot_align(sizeof(SnapshotHeader));
+        header.keys_offset = snapshot_align(header.offsets_offset +
+                                            (buckets + 1) * sizeof(uint64_t));
+        header.values_offset = snapshot_align(header.keys_offset + elements * sizeof(KeyType));
+        header.file_size = header.values_offset + elements * sizeof(ValueType);
+
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        uint64_t written = 0;
+        auto write = [&](const void* data, size_t size) {
+            file.write(static_cast<const char*>(data), size);
+            written += size;
+        };
+        auto pad_to = [&](uint64_t offset) {
+            static const char zeros[SNAPSHOT_ALIGNMENT] = {};
+            write(zeros, offset - written);
+        };
+        write(&header, sizeof(header));
+        pad_to(header.offsets_offset);
+        write(offsets.data(), offsets.size() * sizeof(uint64_t));
+        pad_to(header.keys_offset);
+        for (size_t position : order) {
+            write(&value_store_.key(position), sizeof(KeyType));
+        }
+        pad_to(header.values_offset);
+        for (size_t position : order) {
+            write(&value_store_.value(position), sizeof(ValueType));
+        }
+        file.close();
+        if (!file) {
+            throw std::runtime_error("Can't write snapshot " + path);
+        }
+    }
+
+#if __has_include(<sys/mman.h>)
+    /* Maps snapshot file written by save and serves lookups right from the mapped pages,
+    see MappedHashMap. Time: O(1). */
+    static MappedHashMap<KeyType, ValueType, Hash, KeyEqual> open_mmap(const std::string& path,
+                                  const Hash& hasher = Hash(),
+                                  const KeyEqual& key_equal = KeyEqual()) {
+        return MappedHashMap<KeyType, ValueType, Hash, KeyEqual>(path, hasher, key_equal);
+    }
+#endif
+
+    /* Turns the table into read-only FrozenHashMap with minimal perfect hash index. Elements
+    are permuted in place into the slots of the function and moved into the result, the table
+    is left empty. Time: expected O(quantity of elements in the table). */
+    FrozenHashMap<KeyType, ValueType, Hash, KeyEqual, Allocator, StoragePolicy> freeze() && {
+        std::vector<size_t> hashes(value_store_.size());
+        for (size_t i = 0; i < hashes.size(); i++) {
+            hashes[i] = position_hash(i);
+        }
+        std::vector<size_t> slots;
+        MinimalPerfectHash function(hashes, slots);
+        // Every cycle of the permutation is rotated by swaps, each swap puts one element home.
+        for (size_t i = 0; i < slots.size(); i++) {
+            while (slots[i] != i) {
+                size_t target = slots[i];
+                value_store_.swap_elements(i, target);
+                std::swap(slots[i], slots[target]);
+            }
+        }
+        FrozenHashMap<KeyType, ValueType, Hash, KeyEqual, Allocator, StoragePolicy> result(
+                    std::move(value_store_), std::move(function), hasher_, key_equal_);
+        clear();
+        return result;
+    }
+
+    // The same as freeze above, but the table is copied and stays unchanged.
+    FrozenHashMap<KeyType, ValueType, Hash, KeyEqual, Allocator, StoragePolicy> freeze() const & {
+        return HashMap(*this).freeze();
+    }
+
+    // Returns hash function, used by hash table. Time: O(1).
+    const Hash hash_function() const {
+        return hasher_;
+    }
+
+    // Returns key comparator, used by hash table. Time: O(1).
+    const KeyEqual key_eq() const {
+        return key_equal_;
+    }
+
+    // Returns allocator, used by hash table. Time: O(1).
+    Allocator get_allocator() const {
+        return Allocator(value_store_.get_allocator());
+    }
+
+    /* Random access range over all keys in the order of iteration. With SplitStorage it is
+    a contiguous array. Time: O(1). */
+    IteratorRange<typename Store::key_iterator> keys() const {
+        return value_store_.keys();
+    }
+
+    /* Random access range over all values in the order of iteration, values can be changed.
+    With SplitStorage it is a contiguous array, so aggregations over it can be vectorized.
+    Time: O(1). */
+    IteratorRange<typename Store::value_iterator> values() {
+        return value_store_.values();
+    }
+
+    // Constant range over all values. Time: O(1).
+    IteratorRange<typename Store::const_value_iterator> values() const {
+        return value_store_.values();
+    }
+
+    // Iterator points to the first element in hash_table. Time: O(1).
+    iterator begin() {
+        return {0, this};
+    }
+
+    // Constant iterator points to the first element in hash_table. Time: O(1).
+    const_iterator begin() const {
+        return {0, this};
+    }
+
+    // Iterator points behind the last element in hash_table. Time: O(1).
+    iterator end() {
+        return {value_store_.size(), this};
+    }
+
+    /* Constant iterator points behind the last 
+    element in hash_table. Time: O(1). */
+    const_iterator end() const {
+        return {value_store_.size(), this};
+    }
+
+    /* Returns iterator to the element if this element is in
+     the table ot iterator end() otherwise. Time: expected O(1). */
+    iterator find(const KeyType& key) {
+        hashed_pointers_.advance(position_hasher());
+        return {key_position(key), this};
+    }
+
+    /* Returns constant iterator to the element if this element is in the 
+    table ot constant iterator end() otherwise. Time: expected O(1). */
+    const_iterator find(const KeyType& key) const {
+        return {key_position(key), this};
+    }
+
+    /* Heterogeneous find: if both Hash and KeyEqual have is_transparent member type,
+    any key type that they accept can be used without
+    constructing KeyType (for example std::string_view for std::string keys).
+    The same works for contains, count, erase and at. Time: expected O(1). */
+    template<class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+    iterator find(const K& key) {
+        hashed_pointers_.advance(position_hasher());
+        return {key_position(key), this};
+    }
+
+    // Constant heterogeneous find. Time: expected O(1).
+    template<class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+    const_iterator find(const K& key) const {
+        return {key_position(key), this};
+    }
+
+    /* find with the hash computed by the caller, it must be hash_function()(key). For callers
+    that need the hash anyway (ConcurrentHashMap chooses the shard by it), so the key is hashed
+    once. Time: expected O(1). */
+    iterator find_hashed(size_t hash, const KeyType& key) {
+        hashed_pointers_.advance(position_hasher());
+        return {hashed_position(hash, key), this};
+    }
+
+    // Constant find_hashed. Time: expected O(1).
+    const_iterator find_hashed(size_t hash, const KeyType& key) const {
+        return {hashed_position(hash, key), this};
+    }
+
+    // Returns true if the key is in the table. Time: expected O(1).
+    bool contains(const KeyType& key) const {
+        return key_position(key) != value_store_.size();
+    }
+
+    // Heterogeneous contains. Time: expected O(1).
+    template<class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+    bool contains(const K& key) const {
+        return key_position(key) != value_store_.size();
+    }
+
+    /* Finds count keys from keys array and writes iterators to them (or end()) into out.
+    Keys are processed in groups of BATCH_SIZE_: all keys of the group are hashed and
+    their index places are prefetched, then the first candidate of every key is found and
+    its value_store_ slot is prefetched, and only then the keys are compared. So cache misses
+    of different keys overlap instead of waiting for each other, that helps for tables much
+    bigger than the cache. Time: expected O(count). */
+    void find_batch(const KeyType* keys, size_t count, iterator* out) {
+        hashed_pointers_.advance(position_hasher());
+        batch_positions(keys, count, [&](size_t i, size_t position) {
+            out[i] = {position, this};
+        });
+    }
+
+    // Constant batched find. Time: expected O(count).
+    void find_batch(const KeyType* keys, size_t count, const_iterator* out) const {
+        batch_positions(keys, count, [&](size_t i, size_t position) {
+            out[i] = {position, this};
+        });
+    }
+
+    // Batched contains, out[i] is true if keys[i] is in the table. Time: expected O(count).
+    void contains_batch(const KeyType* keys, size_t count, bool* out) const {
+        batch_positions(keys, count, [&](size_t i, size_t position) {
+            out[i] = position != value_store_.size();
+        });
+    }
+
+    // Returns number of elements with the key, that is 0 or 1. Time: expected O(1).
+    size_t count(const KeyType& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    // Heterogeneous count. Time: expected O(1).
+    template<class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+    size_t count(const K& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    /* Removes element from the hash_table. Returns number of removed elements (0 or 1). The
+    key is hashed once and its bucket is probed once: the index drops the position in the same
+    search that finds it. If the load falls below min_load_factor, the storage shrinks and the
+    index is rebuilt (check_and_shrink), which invalidates all iterators and references.
+    Time: expected O(1), amortized O(1) with the shrink. */
+    size_t erase(const KeyType& key) {
+        return erase_key(key);
+    }
+
+    // Heterogeneous erase. Time: expected O(1).
+    template<class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+    size_t erase(const K& key) {
+        return erase_key(key);
+    }
+
+    // erase with the hash computed by the caller, as in find_hashed. Time: expected O(1).
+    size_t erase_hashed(size_t hash, const KeyType& key) {
+        return indexed() ? erase_hashed_key(hash, key) : erase_key(key);
+    }
+
+    /* Removes the element at the iterator without comparing keys. The back element takes
+    its place, so the returned iterator (at the same position) points to the element, that was
+    not visited yet, and it = erase(it) loops visit every element once. Time: expected O(1). */
+    iterator erase(iterator position) {
+        erase_position(position.index());
+        return {position.index(), this};
+    }
+
+    // The same as erase above for constant iterator.
+    iterator erase(const_iterator position) {
+        erase_position(position.index());
+        return {position.index(), this};
+    }
+
+    /* Removes every element, for which predicate(element) is true, and returns their number.
+    value_store_ is compacted in one pass with the order of the rest kept, then the index is
+    rebuilt once (hashes are not computed again with CacheHash), so a sweep that removes
+    many elements costs no per-element index fixups. The predicate takes ElementReference to
+    constant value and must not throw. Time: O(quantity of elements in the table). */
+    template<class Predicate>
+    size_t erase_if(Predicate predicate) {
+        return remove_positions([&](size_t position) {
+            return predicate(static_cast<const Store&>(value_store_).element(position));
+        });
+    }
+
+    /* Inserts element into the hash table only if there was not such element.
+    Returns iterator to the element with this key and true if it was inserted.
+    Calls check_and_reallocate. Time: expected and amortized O(1).
+    O(quantity of elements in the table) while reallocation. */
+    std::pair<iterator, bool> insert(const std::pair<KeyType, ValueType>& key_value) {
+        return try_emplace(key_value.first, key_value.second);
+    }
+
+    // The same as insert above, but key and value are moved into the table.
+    std::pair<iterator, bool> insert(std::pair<KeyType, ValueType>&& key_value) {
+        return try_emplace(std::move(key_value.first), std::move(key_value.second));
+    }
+
+    /* If there is no such key, constructs value from args right in value_store_.
+    Otherwise does nothing, args are not moved from. The key is hashed once.
+    Time: expected and amortized O(1). */
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace(const KeyType& key, Args&&... args) {
+        auto result = emplace_position(key, std::forward<Args>(args)...);
+        return {{result.first, this}, result.second};
+    }
+
+    // The same as try_emplace above, but the key is moved into the table.
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace(KeyType&& key, Args&&... args) {
+        auto result = emplace_position(std::move(key), std::forward<Args>(args)...);
+        return {{result.first, this}, result.second};
+    }
+
+    /* try_emplace with the hash computed by the caller, it must be hash_function()(key). For
+    callers that hash keys in batches (HashCounter::add_all), so every key is hashed once.
+    Time: expected and amortized O(1). */
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace_hashed(size_t hash, const KeyType& key,
+                                                 Args&&... args) {
+        auto result = emplace_hashed_position(hash, key, std::forward<Args>(args)...);
+        return {{result.first, this}, result.second};
+    }
+
+    // The same as try_emplace_hashed above, but the key is moved into the table.
+    template<class... Args>
+    std::pair<iterator, bool> try_emplace_hashed(size_t hash, KeyType&& key, Args&&... args) {
+        auto result = emplace_hashed_position(hash, std::move(key), std::forward<Args>(args)...);
+        return {{result.first, this}, result.second};
+    }
+
+    /* Prefetches the index place of the hash, so try_emplace_hashed issued a few keys later
+    doesn't wait for memory. Time: O(1). */
+    void prefetch_hashed(size_t hash) const {
+        if (indexed()) {
+            hashed_pointers_.prefetch(hash);
+        }
+    }
+
+    // Result of insert of a node: the node comes back if its key was already in the table.
+    struct insert_return_type {
+        iterator position;
+        bool inserted;
+        node_type node;
+    };
+
+    /* Moves the key and the value of the node into the table, if there is no such key.
+    Otherwise they stay in the returned node. Empty node inserts nothing and gives end().
+    Time: expected and amortized O(1). */
+    insert_return_type insert(node_type&& node) {
+        if (node.empty()) {
+            return {end(), false, node_type()};
+        }
+        auto result = emplace_position(std::move(node.key()), std::move(node.mapped()));
+        if (!result.second) {
+            return {{result.first, this}, false, std::move(node)};
+        }
+        node = node_type();
+        return {{result.first, this}, true, node_type()};
+    }
+
+    /* Takes the element at the iterator out of the table into a node, the back element takes
+    its place as with erase. Time: expected O(1). */
+    node_type extract(const_iterator position) {
+        return extract_position(position.index());
+    }
+
+    // Takes the element with the key out, or returns empty node. Time: expected O(1).
+    node_type extract(const KeyType& key) {
+        size_t position = key_position(key);
+        if (position == value_store_.size()) {
+            return node_type();
+        }
+        return extract_position(position);
+    }
+
+    /* Moves every element of source, whose key is not in this table, into this table (keys
+    and values are moved, not copied), the others stay in source. Source may have other hash,
+    comparator, index, storage and stats policies. It is compacted and its index is rebuilt
+    once, as in erase_if. An empty table with stateless hash and comparator takes all arrays
+    of source with the same type at once. Time: expected O(source.size()). */
+    template<class OtherHash, class OtherKeyEqual, class OtherIndex, bool OtherCacheHash,
+             class OtherStorage, class OtherStats>
+    void merge(HashMap<KeyType, ValueType, OtherHash, OtherKeyEqual, Allocator, OtherIndex,
+                       OtherCacheHash, OtherStorage, OtherStats>& source) {
+        using Source = typename std::remove_reference<decltype(source)>::type;
+        if constexpr (std::is_same<Source, HashMap>::value) {
+            if (&source == this) {
+                return;
+            }
+            if (empty() && std::is_empty<Hash>::value && std::is_empty<KeyEqual>::value &&
+                                get_allocator() == source.get_allocator()) {
+                using std::swap;
+                swap(value_store_, source.value_store_);
+                swap(hash_store_, source.hash_store_);
+                swap(hashed_pointers_, source.hashed_pointers_);
+                if (indexed()) {
+                    check_and_reallocate();
+                }
+                return;
+            }
+        }
+        source.remove_positions([&](size_t position) {
+            return emplace_position(source.value_store_.movable_key(position),
+                                    std::move(source.value_store_.value(position))).second;
+        });
+    }
+
+    // The same as merge above, for a source that is going away.
+    template<class OtherHash, class OtherKeyEqual, class OtherIndex, bool OtherCacheHash,
+             class OtherStorage, class OtherStats>
+    void merge(HashMap<KeyType, ValueType, OtherHash, OtherKeyEqual, Allocator, OtherIndex,
+                       OtherCacheHash, OtherStorage, OtherStats>&& source) {
+        merge(source);
+    }
+
+    /* Adds every element of other: a new key is inserted with a copy of its value, for a key
+    that is already here combine(ValueType& value, const ValueType& other_value) updates the
+    value. other may have any hash, comparator, allocator and policies. Its value_store_ is
+    read in order, capacity for all its keys is reserved before the first insert, and if other
+    caches hashes of the same hash function (see same_hashes) its keys are not hashed again.
+    Returns number of inserted keys. Time: expected O(other.size()). */
+    template<class Combine, class OtherHash, class OtherKeyEqual, class OtherAllocator,
+             class OtherIndex, bool OtherCacheHash, class OtherStorage, class OtherStats>
+    size_t merge_with(const HashMap<KeyType, ValueType, OtherHash, OtherKeyEqual, OtherAllocator,
+                                    OtherIndex, OtherCacheHash, OtherStorage, OtherStats>& other,
+                      Combine combine) {
+        return merge_positions<false>(other, combine);
+    }
+
+    /* The same as merge_with above, but new keys and values are moved out of other, combine
+    gets ValueType&& of other, and other is cleared at the end. Time: expected O(other.size()). */
+    template<class Combine, class OtherHash, class OtherKeyEqual, class OtherAllocator,
+             class OtherIndex, bool OtherCacheHash, class OtherStorage, class OtherStats>
+    size_t merge_with(HashMap<KeyType, ValueType, OtherHash, OtherKeyEqual, OtherAllocator,
+                              OtherIndex, OtherCacheHash, OtherStorage, OtherStats>&& other,
+                      Combine combine) {
+        if (static_cast<const void*>(&other) == this) {
+            return 0;
+        }
+        size_t inserted = merge_positions<true>(other, combine);
+        other.clear();
+        return inserted;
+    }
+
+    /* In-place union: inserts copies of the elements of other, whose keys are not here, the
+    values of common keys stay as they are. Returns number of inserted keys.
+    Time: expected O(other.size()). */
+    template<class OtherHash, class OtherKeyEqual, class OtherAllocator, class OtherIndex,
+             bool OtherCacheHash, class OtherStorage, class OtherStats>
+    size_t union_with(const HashMap<KeyType, ValueType, OtherHash, OtherKeyEqual, OtherAllocator,
+                                    OtherIndex, OtherCacheHash, OtherStorage, OtherStats>& other) {
+        return merge_with(other, [](ValueType&, const ValueType&) {});
+    }
+
+    /* In-place intersection: removes elements, whose keys are not in other (its values are
+    not used). Survivors keep their order and the index is rebuilt once, as in erase_if.
+    Cached hashes of this table are used for lookups in other, if the hash functions are the
+    same. Returns number of removed elements. Time: expected O(size()). */
+    template<class OtherValue, class OtherHash, class OtherKeyEqual, class OtherAllocator,
+             class OtherIndex, bool OtherCacheHash, class OtherStorage, class OtherStats>
+    size_t intersect(const HashMap<KeyType, OtherValue, OtherHash, OtherKeyEqual, OtherAllocator,
+                                   OtherIndex, OtherCacheHash, OtherStorage, OtherStats>& other) {
+        if (static_cast<const void*>(&other) == this) {
+            return 0;
+        }
+        bool shared = same_hashes(hasher_, other.hasher_);
+        return remove_positions([&](size_t position) {
+            return !other.contains_hashed(*this, position, shared);
+        });
+    }
+
+    /* In-place difference: removes elements, whose keys are in other. If other is much
+    smaller, its keys are erased one by one (the back element fills every hole, as in erase),
+    otherwise this table is swept once keeping the order, as in intersect. Returns number of
+    removed elements. Time: expected O(min(size(), other.size()) + rebuild of the index). */
+    template<class OtherValue, class OtherHash, class OtherKeyEqual, class OtherAllocator,
+             class OtherIndex, bool OtherCacheHash, class OtherStorage, class OtherStats>
+    size_t difference(const HashMap<KeyType, OtherValue, OtherHash, OtherKeyEqual,
+                                    OtherAllocator, OtherIndex, OtherCacheHash, OtherStorage,
+                                    OtherStats>& other) {
+        if (static_cast<const void*>(&other) == this) {
+            size_t removed = size();
+            clear();
+            return removed;
+        }
+        bool shared = same_hashes(hasher_, other.hasher_);
+        if (other.size() * DIFFERENCE_SWEEP_RATIO_ < size()) {
+            size_t removed = 0;
+            for (size_t position = 0; position < other.value_store_.size(); position++) {
+                const KeyType& key = other.value_store_.key(position);
+                removed += indexed() ? erase_hashed_key(hash_of(other, position, shared), key)
+                                     : erase_key(key);
+            }
+            return removed;
+        }
+        return remove_positions([&](size_t position) {
+            return other.contains_hashed(*this, position, shared);
+        });
+    }
+
+    /* Constructs std::pair<KeyType, ValueType> from args (one pair or piecewise) and moves it
+    into the table if there was no such key: the key and value are moved once more than by
+    try_emplace, and they are constructed even if the key is present.
+    Time: expected and amortized O(1). */
+    template<class... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        return insert(std::pair<KeyType, ValueType>(std::forward<Args>(args)...));
+    }
+
+    /* emplace(key, value) is try_emplace: the value is constructed right in value_store_ and
+    only if there is no such key. A key of another type is converted to KeyType first.
+    Time: expected and amortized O(1). */
+    template<class K, class V>
+    std::pair<iterator, bool> emplace(K&& key, V&& value) {
+        if constexpr (std::is_same<typename std::decay<K>::type, KeyType>::value) {
+            auto result = emplace_position(std::forward<K>(key), std::forward<V>(value));
+            return {{result.first, this}, result.second};
+        } else {
+            return emplace(KeyType(std::forward<K>(key)), std::forward<V>(value));
+        }
+    }
+
+    /* Inserts the value if there is no such key, otherwise assigns it to the existing
+    element. Time: expected and amortized O(1). */
+    template<class M>
+    std::pair<iterator, bool> insert_or_assign(const KeyType& key, M&& value) {
+        auto result = emplace_position(key, std::forward<M>(value));
+        if (!result.second) {
+            value_store_.value(result.first) = std::forward<M>(value);
+        }
+        return {{result.first, this}, result.second};
+    }
+
+    // The same as insert_or_assign above, but the key is moved into the table.
+    template<class M>
+    std::pair<iterator, bool> insert_or_assign(KeyType&& key, M&& value) {
+        auto result = emplace_position(std::move(key), std::forward<M>(value));
+        if (!result.second) {
+            value_store_.value(result.first) = std::forward<M>(value);
+        }
+        return {{result.first, this}, result.second};
+    }
+
+    /* Returns reference to the value if this key is in the table. 
+    Throws out_of_range exception otherwise. Time: expected O(1) */
+    const ValueType& at(const KeyType& key) const {
+        return value_store_.value(at_position(key));
+    }
+
+    // Heterogeneous at. Time: expected O(1).
+    template<class K, class = EnableIfTransparent<Hash, KeyEqual, K>>
+    const ValueType& at(const K& key) const {
+        return value_store_.value(at_position(key));
+    }
+
+    /* Returns reference to the value if this key is in the table.
+    Otherwise put default value into hashtable. The key is hashed and
+    looked up once. Time: expected O(1) */
+    ValueType& operator[](const KeyType& key) {
+        return value_store_.value(emplace_position(key).first);
+    }
+
+    // The same as operator[] above, but new key is moved into the table.
+    ValueType& operator[](KeyType&& key) {
+        return value_store_.value(emplace_position(std::move(key)).first);
+    }
+
+    /* Clears hash table and frees the index, the next elements up to Store::INLINE_CAPACITY
+    are scanned linearly again. Time: O(quantity of elements in the table) */
+    void clear() {
+        value_store_.clear();
+        hash_store_.clear();
+        hashed_pointers_.clear();
+    }
+
+    /* Clears hash table, but keeps the buckets and the memory of value_store_, so a table
+    that is filled and cleared again and again doesn't regrow every time.
+    Time: O(quantity of elements in the table + bucket_count). */
+    void clear_keep_capacity() {
+        hashed_pointers_.reset();
+        value_store_.clear();
+        hash_store_.clear();
+    }
+
+    /* Gives back spare memory: value_store_ fits its elements and the index is rebuilt
+    with the smallest bucket count for max_load_factor(). A table of at most
+    Store::INLINE_CAPACITY elements drops the index and returns to the linear mode.
+    Time: O(quantity of elements in the table). */
+    void shrink_to_fit() {
+        value_store_.shrink_to_fit();
+        if (value_store_.size() <= Store::INLINE_CAPACITY) {
+            drop_index();
+            return;
+        }
+        hash_store_.shrink_to_fit();
+        rehash(0);
+    }
+
+ private:
+    using IndexAllocator = typename std::allocator_traits<Allocator>::template
+                                    rebind_alloc<size_t>;
+    using Index = typename IndexPolicy::template rebind<IndexAllocator>;
+
+    Store value_store_;
+    // Hashes of keys from value_store_, filled only when CacheHash is true.
+    std::vector<size_t, IndexAllocator> hash_store_;
+    Index hashed_pointers_;
+    Hash hasher_;
+    KeyEqual key_equal_;
+    float max_load_factor_ = DEFAULT_MAX_LOAD_FACTOR_;
+    float min_load_factor_ = 0;
+    // Mutable: constant lookups are counted too. NoStats takes no place.
+#if __has_cpp_attribute(no_unique_address)
+    [[no_unique_address]]
+#endif
+    mutable StatsPolicy stats_;
+    constexpr static size_t INCREMENT_FACTOR_ = 2;
+    constexpr static float DEFAULT_MAX_LOAD_FACTOR_ = 2.0f / 3;
+    constexpr static float MIN_LOAD_FACTOR_ = 1.0f / 64;
+    // min_load_factor_ is at most max_load_factor_ / HYSTERESIS_.
+    constexpr static float HYSTERESIS_ = 4;
+    // Number of lookups in flight in find_batch.
+    constexpr static size_t BATCH_SIZE_ = 16;
+    // difference erases keys of other one by one, if other is this many times smaller.
+    constexpr static size_t DIFFERENCE_SWEEP_RATIO_ = 8;
+    constexpr static bool NOTHROW_MOVE_CONSTRUCTIBLE_ =
+                        std::is_nothrow_move_constructible<Store>::value &&
+                        std::is_nothrow_move_constructible<Index>::value &&
+                        std::is_nothrow_move_constructible<Hash>::value &&
+                        std::is_nothrow_move_constructible<KeyEqual>::value;
+    constexpr static bool NOTHROW_MOVE_ASSIGNABLE_ =
+                        std::is_nothrow_move_assignable<Store>::value &&
+                        std::is_nothrow_move_assignable<
+                                std::vector<size_t, IndexAllocator>>::value &&
+                        std::is_nothrow_move_assignable<Index>::value &&
+                        std::is_nothrow_move_assignable<Hash>::value &&
+                        std::is_nothrow_move_assignable<KeyEqual>::value;
+
+    /* False in the linear mode: the index has no buckets, hash_store_ is empty and keys are
+    found by linear scan of value_store_. The table is in this mode while it holds at most
+    Store::INLINE_CAPACITY elements and nothing asked for buckets. Time: O(1). */
+    bool indexed() const {
+        return hashed_pointers_.bucket_count() != 0;
+    }
+
+    // Fills hash_store_ if the table leaves the linear mode. Time: O(quantity of elements).
+    void fill_hash_store() {
+        if (CacheHash && !indexed()) {
+            hash_store_.clear();
+            hash_store_.reserve(value_store_.size());
+            for (size_t i = 0; i < value_store_.size(); i++) {
+                hash_store_.push_back(hasher_(value_store_.key(i)));
+            }
+        }
+    }
+
+    // Rebuilds the index with bucket_count buckets, leaving the linear mode.
+    void build_index(size_t bucket_count) {
+        fill_hash_store();
+        rebuild_index(bucket_count);
+    }
+
+    // Frees the index and cached hashes, the table goes to the linear mode.
+    void drop_index() {
+        hashed_pointers_.clear();
+        std::vector<size_t, IndexAllocator>(hash_store_.get_allocator()).swap(hash_store_);
+    }
+
+    // Runs rebuild of the index, the stats policy counts it with its time.
+    template<class Rebuild>
+    void timed_rebuild(Rebuild rebuild) {
+        if constexpr (StatsPolicy::ENABLED) {
+            auto start = std::chrono::steady_clock::now();
+            rebuild();
+            stats_.rehash(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - start).count());
+        } else {
+            rebuild();
+        }
+    }
+
+    // Rebuilds the index for all elements of value_store_. Time: O(elements + bucket_count).
+    void rebuild_index(size_t bucket_count) {
+        timed_rebuild([&] {
+            hashed_pointers_.rebuild(bucket_count, value_store_.size(), position_hasher());
+        });
+    }
+
+    // The smallest bucket count, that holds count elements without growth. Time: O(1).
+    size_t min_bucket_count(size_t count) const {
+        return static_cast<size_t>(static_cast<double>(count) / max_load_factor_) + 1;
+    }
+
+    /* This method rebuilds table when quantity of elements becomes more 
+     than max_load_factor_ of hash table capacity. 
+     It increments size of the table in INCREMENT_FACTOR_ times. 
+     Time: O(quantity of elements in the table). */
+    void check_and_reallocate() {
+        if (value_store_.size() >=
+                        hashed_pointers_.bucket_count() * static_cast<double>(max_load_factor_)) {
+            size_t new_size = std::max(hashed_pointers_.bucket_count() * INCREMENT_FACTOR_,
+                                       min_bucket_count(value_store_.size()));
+            rebuild_index(new_size);
+#if defined(HASH_MAP_DEBUG)
+            warn_if_skewed();
+#endif
+        }
+        return;
+    }
+
+#if defined(HASH_MAP_DEBUG)
+    // Writes one warning per map type, when the index is skewed. Time: O(bucket_count).
+    void warn_if_skewed() const {
+        static std::atomic<bool> warned(false);
+        if (!warned.load(std::memory_order_relaxed) && skewed() && !warned.exchange(true)) {
+            std::fprintf(stderr, "HashMap: the longest chain is %zu with %zu elements in %zu "
+                         "buckets (limit %zu), the hash function is skewed\n",
+                         hashed_pointers_.max_chain_length(), value_store_.size(),
+                         hashed_pointers_.bucket_count(),
+                         hashed_pointers_.skew_limit(value_store_.size()));
+        }
+    }
+#endif
+
+    /* After erase: if load is below min_load_factor_, rebuilds the index with load
+    max_load_factor_ / 2, as right after growth, and shrinks value_store_. A table, that fits
+    Store::INLINE_CAPACITY, drops the index instead.
+    Time: O(1), amortized O(1) for the rebuild. */
+    void check_and_shrink() {
+        if (indexed() && value_store_.size() < hashed_pointers_.bucket_count() *
+                                  static_cast<double>(min_load_factor_)) {
+            value_store_.shrink_to_fit();
+            if (value_store_.size() <= Store::INLINE_CAPACITY) {
+                drop_index();
+                return;
+            }
+            hash_store_.shrink_to_fit();
+            rebuild_index(min_bucket_count(value_store_.size() * INCREMENT_FACTOR_));
+        }
+    }
+
+    /* Returns position of the key and false if it is already in the table. Otherwise
+    appends element with this key and value constructed from args to value_store_ and
+    returns its position and true. Time: expected and amortized O(1). */
+    template<class Key, class... Args>
+    std::pair<size_t, bool> emplace_position(Key&& key, Args&&... args) {
+        size_t hash = indexed() ? hasher_(key) : 0;
+        return emplace_hashed_position(hash, std::forward<Key>(key), std::forward<Args>(args)...);
+    }
+
+    // emplace_position with the hash of the key, that is not used in the linear mode.
+    template<class Key, class... Args>
+    std::pair<size_t, bool> emplace_hashed_position(size_t current_hash, Key&& key,
+                                                    Args&&... args) {
+        if (!indexed()) {
+            size_t position = scan_position(key);
+            if (position != value_store_.size()) {
+                return {position, false};
+            }
+            value_store_.emplace_back(std::forward<Key>(key), std::forward<Args>(args)...);
+            if (value_store_.size() > Store::INLINE_CAPACITY) {
+                build_index(min_bucket_count(value_store_.size() * INCREMENT_FACTOR_));
+            }
+            return {position, true};
+        }
+        hashed_pointers_.advance(position_hasher());
+        size_t position = find_position(current_hash, key);
+        if (position != value_store_.size()) {
+            return {position, false};
+        }
+        value_store_.emplace_back(std::forward<Key>(key), std::forward<Args>(args)...);
+        if (CacheHash) {
+            hash_store_.push_back(current_hash);
+        }
+        hashed_pointers_.insert(current_hash, position, position_hasher());
+        check_and_reallocate();
+        return {position, true};
+    }
+
+    /* Adds elements of other for merge_with, Move = true moves them. Time: expected
+    O(other.size()). */
+    template<bool Move, class Other, class Combine>
+    size_t merge_positions(Other& other, Combine& combine) {
+        bool shared = same_hashes(hasher_, other.hasher_);
+        // Growth is geometric as with inserts, so merges of many small tables stay linear.
+        size_t needed = size() + other.size();
+        if (static_cast<const void*>(&other) != this &&
+                                min_bucket_count(needed) > hashed_pointers_.bucket_count()) {
+            reserve(std::max(needed, 2 * size()));
+        }
+        size_t inserted = 0;
+        for (size_t position = 0; position < other.value_store_.size(); position++) {
+            size_t hash = indexed() ? hash_of(other, position, shared) : 0;
+            std::pair<size_t, bool> result;
+            if constexpr (Move) {
+                result = emplace_hashed_position(hash, other.value_store_.movable_key(position),
+                                                 std::move(other.value_store_.value(position)));
+                if (!result.second) {
+                    combine(value_store_.value(result.first),
+                            std::move(other.value_store_.value(position)));
+                }
+            } else {
+                result = emplace_hashed_position(hash, other.value_store_.key(position),
+                                                 other.value_store_.value(position));
+                if (!result.second) {
+                    combine(value_store_.value(result.first),
+                            static_cast<const ValueType&>(other.value_store_.value(position)));
+                }
+            }
+            inserted += result.second;
+        }
+        return inserted;
+    }
+
+    /* Hash for this table of the element at the position of other: the cached hash of other if
+    the hash functions are the same (shared), otherwise the key is hashed. Time: O(1). */
+    template<class Other>
+    size_t hash_of(const Other& other, size_t position, bool shared) const {
+        if (shared && other.has_cached_hashes()) {
+            return other.hash_store_[position];
+        }
+        return hasher_(other.value_store_.key(position));
+    }
+
+    // hash_store_ keeps the hashes of all elements: CacheHash and the index is built.
+    bool has_cached_hashes() const {
+        return CacheHash && indexed();
+    }
+
+    /* True if the key of the element at the position of other is in this table. Hashes of
+    other are used if they are the same (shared). Time: expected O(1). */
+    template<class Other>
+    bool contains_hashed(const Other& other, size_t position, bool shared) const {
+        const KeyType& key = other.value_store_.key(position);
+        if (!indexed()) {
+            return scan_position(key) != value_store_.size();
+        }
+        return find_position(hash_of(other, position, shared), key) != value_store_.size();
+    }
+
+    /* Calls result(i, position of keys[i]) for every key, the lookups are pipelined in groups
+    as described in find_batch. Time: expected O(count). */
+    template<class Result>
+    void batch_positions(const KeyType* keys, size_t count, Result result) const {
+        if (!indexed()) {
+            for (size_t i = 0; i < count; i++) {
+                result(i, scan_position(keys[i]));
+            }
+            return;
+        }
+        size_t hashes[BATCH_SIZE_];
+        for (size_t begin = 0; begin < count; begin += BATCH_SIZE_) {
+            size_t batch = std::min(BATCH_SIZE_, count - begin);
+            for (size_t i = 0; i < batch; i++) {
+                hashes[i] = hasher_(keys[begin + i]);
+                hashed_pointers_.prefetch(hashes[i]);
+            }
+            for (size_t i = 0; i < batch; i++) {
+                size_t candidate = hashed_pointers_.find(hashes[i], [](size_t) { return true; });
+                if (candidate != Index::NPOS) {
+                    prefetch_memory(&value_store_.key(candidate));
+                    if (CacheHash) {
+                        prefetch_memory(&hash_store_[candidate]);
+                    }
+                }
+            }
+            for (size_t i = 0; i < batch; i++) {
+                result(begin + i, find_position(hashes[i], keys[begin + i]));
+            }
+        }
+    }
+
+    /* Returns position of the key in value_store_ or value_store_.size() if there is no such
+    key, the key is hashed only if there is the index. Time: expected O(1). */
+    template<class K>
+    size_t key_position(const K& key) const {
+        return indexed() ? find_position(hasher_(key), key) : scan_position(key);
+    }
+
+    // key_position with the hash of the key, that is not used in the linear mode.
+    template<class K>
+    size_t hashed_position(size_t hash, const K& key) const {
+        return indexed() ? find_position(hash, key) : scan_position(key);
+    }
+
+    // Linear search without hashing for the linear mode. Time: O(quantity of elements).
+    template<class K>
+    size_t scan_position(const K& key) const {
+        size_t position = 0;
+        while (position < value_store_.size() && !key_equal_(value_store_.key(position), key)) {
+            position++;
+        }
+        if constexpr (StatsPolicy::ENABLED) {
+            bool hit = position != value_store_.size();
+            stats_.lookup(position + hit, hit);
+        }
+        return position;
+    }
+
+    /* Returns position of the key in value_store_ or value_store_.size()
+    if there is no such key. Time: expected O(1). */
+    template<class K>
+    size_t find_position(size_t hash, const K& key) const {
+        size_t probes = 0;
+        size_t position = hashed_pointers_.find(hash, key_matcher(hash, key, probes));
+        stats_.lookup(probes, position != Index::NPOS);
+        return (position == Index::NPOS) ? value_store_.size() : position;
+    }
+
+    /* Match functor for the index: true for the position of the key, its cached hash is
+    compared first. Counts calls in probes, if the stats policy is enabled. */
+    template<class K>
+    auto key_matcher(size_t hash, const K& key, size_t& probes) const {
+        return [this, hash, &key, &probes](size_t x) {
+            if constexpr (StatsPolicy::ENABLED) {
+                probes++;
+            }
+            return (!CacheHash || hash_store_[x] == hash) &&
+                        key_equal_(value_store_.key(x), key);
+        };
+    }
+
+    // Position of the key, throws out_of_range if there is no such key. Time: expected O(1).
+    template<class K>
+    size_t at_position(const K& key) const {
+        size_t position = key_position(key);
+        if (position == value_store_.size()) {
+            throw std::out_of_range("This element doesn't exist");
+        }
+        return position;
+    }
+
+    /* Removes the element with the key, the back element of value_store_ fills its place.
+    Time: expected O(1). */
+    template<class K>
+    size_t erase_key(const K& key) {
+        if (!indexed()) {
+            size_t position = scan_position(key);
+            if (position == value_store_.size()) {
+                return 0;
+            }
+            value_store_.pop_back_into(position);
+            return 1;
+        }
+        return erase_hashed_key(hasher_(key), key);
+    }
+
+    // erase_key with the hash of the key, the index must be built. Time: expected O(1).
+    template<class K>
+    size_t erase_hashed_key(size_t hash, const K& key) {
+        hashed_pointers_.advance(position_hasher());
+        size_t probes = 0;
+        size_t position = hashed_pointers_.erase_match(hash, key_matcher(hash, key, probes),
+                                                       position_hasher());
+        stats_.lookup(probes, position != Index::NPOS);
+        if (position == Index::NPOS) {
+            return 0;
+        }
+        fill_hole(position);
+        return 1;
+    }
+
+    // Removes the element at the position. Time: expected O(1).
+    void erase_position(size_t position) {
+        unlink_position(position);
+        remove_unlinked(position);
+    }
+
+    /* Moves the element at the position into a node and removes it. The index forgets the
+    position while the key is still there to be hashed. Time: expected O(1). */
+    node_type extract_position(size_t position) {
+        unlink_position(position);
+        node_type node;
+        node.element_.emplace(value_store_.movable_key(position),
+                              std::move(value_store_.value(position)));
+        remove_unlinked(position);
+        return node;
+    }
+
+    // Removes the position from the index, the element stays in value_store_. Time: expected O(1).
+    void unlink_position(size_t position) {
+        if (indexed()) {
+            hashed_pointers_.advance(position_hasher());
+            hashed_pointers_.erase(position_hash(position), position, position_hasher());
+        }
+    }
+
+    // Removes the element, that unlink_position took out of the index. Time: expected O(1).
+    void remove_unlinked(size_t position) {
+        if (indexed()) {
+            fill_hole(position);
+        } else {
+            value_store_.pop_back_into(position);
+        }
+    }
+
+    /* Removes every position, for which remove(position) is true, keeping the order of the
+    rest, and rebuilds the index once. If remove throws, the positions from that one on are
+    kept and the table stays consistent. Returns the number of removed elements.
+    Time: O(quantity of elements in the table). */
+    template<class Remove>
+    size_t remove_positions(Remove remove) {
+        size_t size = value_store_.size();
+        size_t kept = 0;
+        auto keep = [&](size_t i) {
+            if (kept != i) {
+                value_store_.move_into(i, kept);
+                if (CacheHash && indexed()) {
+                    hash_store_[kept] = hash_store_[i];
+                }
+            }
+            kept++;
+        };
+        size_t i = 0;
+        try {
+            for (; i < size; i++) {
+                if (!remove(i)) {
+                    keep(i);
+                }
+            }
+        } catch (...) {
+            for (; i < size; i++) {
+                keep(i);
+            }
+            drop_positions(size, kept);
+            throw;
+        }
+        drop_positions(size, kept);
+        return size - kept;
+    }
+
+    // Truncates value_store_ to kept of size elements and rebuilds the index for them.
+    void drop_positions(size_t size, size_t kept) {
+        if (kept == size) {
+            return;
+        }
+        value_store_.truncate(kept);
+        if (indexed()) {
+            if (CacheHash) {
+                hash_store_.resize(kept);
+            }
+            // Postponed work of the index refers to old positions, so it is dropped first.
+            hashed_pointers_.reset();
+            rebuild_index(hashed_pointers_.bucket_count());
+            check_and_shrink();
+        }
+    }
+
+    /* The position is already removed from the index: the back element of value_store_ is
+    moved into it and renamed in the index. Time: expected O(1). */
+    void fill_hole(size_t index0) {
+        size_t index1 = value_store_.size() - 1;
+        if (index0 != index1) {
+            hashed_pointers_.replace(position_hash(index1), index1, index0);
+            if (CacheHash) {
+                hash_store_[index0] = hash_store_.back();
+            }
+        }
+        value_store_.pop_back_into(index0);
+        if (CacheHash) {
+            hash_store_.pop_back();
+        }
+        check_and_shrink();
+    }
+
+    // Hash of the key stored at the given position. Time: O(1) with CacheHash.
+    size_t position_hash(size_t position) const {
+        if (CacheHash && indexed()) {
+            return hash_store_[position];
+        }
+        return hasher_(value_store_.key(position));
+    }
+
+    // Functor that gives hash of the key stored at the given position.
+    auto position_hasher() const {
+        return [this](size_t position) {
+            return position_hash(position);
+        };
+    }
+};
+
+// Time: O(1).
+template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+         class IndexPolicy, bool CacheHash, class StoragePolicy, class StatsPolicy>
+void swap(HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator, IndexPolicy, CacheHash,
+                  StoragePolicy, StatsPolicy>& first,
+          HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator, IndexPolicy, CacheHash,
+                  StoragePolicy, StatsPolicy>& second) noexcept(noexcept(first.swap(second))) {
+    first.swap(second);
+}
+
+#if defined(__cpp_lib_memory_resource)
+/* HashMap that takes all its memory (elements, index, cached hashes) from std::pmr::memory_resource.
+With std::pmr::monotonic_buffer_resource over a local buffer a short-lived map makes no calls to
+malloc at all and is released at once together with the resource. */
+template<class KeyType, class ValueType, class Hash = std::hash<KeyType>,
+                            class KeyEqual = std::equal_to<KeyType>,
+                            class IndexPolicy = ChainedIndex<>,
+                            bool CacheHash = false,
+                            class StoragePolicy = PairStorage,
+                            class StatsPolicy = NoStats>
+using PmrHashMap = HashMap<KeyType, ValueType, Hash, KeyEqual,
+            std::pmr::polymorphic_allocator<std::pair<const KeyType, ValueType>>,
+            IndexPolicy, CacheHash, StoragePolicy, StatsPolicy>;
+#endif
+
+/* Threading policies choose the table, that ConfiguredHashMap makes of the other policies:
+    map<KeyType, ValueType, Hash, KeyEqual, Allocator, IndexPolicy, CacheHash, StoragePolicy,
+        StatsPolicy>
+ShardedLocking (concurrent_hash_map.h) gives ConcurrentHashMap and ReadCopyUpdate
+(read_mostly_hash_map.h) gives ReadMostlyHashMap. */
+
+// Plain HashMap without any synchronization.
+struct SingleThreaded {
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+             class IndexPolicy, bool CacheHash, class StoragePolicy, class StatsPolicy>
+    using map = HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator, IndexPolicy, CacheHash,
+                        StoragePolicy, StatsPolicy>;
+};
+
+/* All policies of a table in one type, so a configuration is named once and changed one
+policy at a time, everything is resolved at compile time:
+    using Sessions = HashMapPolicies<GroupProbingIndex<>, true>::with_sizing<PowerOfTwoSizing>
+                                                               ::with_threading<ShardedLocking>;
+    ConfiguredHashMap<uint64_t, Session, Sessions, WyHash<uint64_t>> table;
+Index layout and bucket sizing come from IndexPolicy (with_sizing changes the sizing of it). */
+template<class IndexPolicy = ChainedIndex<>, bool CacheHash = false,
+                            class StoragePolicy = PairStorage, class StatsPolicy = NoStats,
+                            class ThreadingPolicy = SingleThreaded>
+struct HashMapPolicies {
+    using index = IndexPolicy;
+    constexpr static bool CACHE_HASH = CacheHash;
+    using storage = StoragePolicy;
+    using stats = StatsPolicy;
+    using threading = ThreadingPolicy;
+
+    template<class OtherIndex>
+    using with_index = HashMapPolicies<OtherIndex, CacheHash, StoragePolicy, StatsPolicy,
+                                       ThreadingPolicy>;
+
+    template<class Sizing>
+    using with_sizing = with_index<typename IndexPolicy::template with_sizing<Sizing>>;
+
+    template<bool OtherCacheHash>
+    using with_cache_hash = HashMapPolicies<IndexPolicy, OtherCacheHash, StoragePolicy,
+                                            StatsPolicy, ThreadingPolicy>;
+
+    template<class OtherStorage>
+    using with_storage = HashMapPolicies<IndexPolicy, CacheHash, OtherStorage, StatsPolicy,
+                                         ThreadingPolicy>;
+
+    template<class OtherStats>
+    using with_stats = HashMapPolicies<IndexPolicy, CacheHash, StoragePolicy, OtherStats,
+                                       ThreadingPolicy>;
+
+    template<class OtherThreading>
+    using with_threading = HashMapPolicies<IndexPolicy, CacheHash, StoragePolicy, StatsPolicy,
+                                           OtherThreading>;
 };
 
+// Table made of the bundle of policies, see HashMapPolicies.
+template<class KeyType, class ValueType, class Policies = HashMapPolicies<>,
+                            class Hash = std::hash<KeyType>,
+                            class KeyEqual = std::equal_to<KeyType>,
+                            class Allocator = std::allocator<std::pair<const KeyType, ValueType>>>
+using ConfiguredHashMap = typename Policies::threading::template map<KeyType, ValueType, Hash,
+            KeyEqual, Allocator, typename Policies::index, Policies::CACHE_HASH,
+            typename Policies::storage, typename Policies::stats>;
 
+#endif  // HASH_MAP_2_H_
@@ -0,0 +1,439 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+/* Benchmarks of HashMap against std::unordered_map, absl::flat_hash_map and
+ankerl::unordered_dense::map (the last two are taken if their headers are found). Build and run
+with Google Benchmark, results go to JSON for regression tracking:
+    g++ -std=c++17 -O2 -DNDEBUG hash_map_benchmark.cpp -o hash_map_benchmark -lbenchmark -lpthread \
+        -labsl_hash -labsl_city -labsl_low_level_hash -labsl_raw_hash_set
+    ./hash_map_benchmark --benchmark_out=results.json --benchmark_out_format=json
+Without abseil libraries define HASH_MAP_BENCHMARK_NO_ABSL and drop the -labsl flags. Two result
+files are compared with compare.py of Google Benchmark (tools/compare.py benchmarks a.json b.json).
+
+Every benchmark is named operation/table/key type/distribution/elements: operations are insert,
+hit and miss lookups, erase, iteration, operator[] increment and rehash (grow to twice the
+buckets and shrink back). Key types are uint64_t, strings of 20 characters (longer than the
+small string buffer) and uint64_t with 256-byte values. Lookups and increments take keys
+uniformly or Zipf distributed (s = 0.99, as in YCSB). Sizes are chosen from the caches of the
+machine: half of L1, half of L2, half of the last level cache and 10 times it.
+--max_elements=N drops larger sizes (quick runs), items_per_second is operations per second. */
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#if __has_include(<absl/container/flat_hash_map.h>) && !defined(HASH_MAP_BENCHMARK_NO_ABSL)
+#include <absl/container/flat_hash_map.h>
+#define HASH_MAP_BENCHMARK_ABSL
+#endif
+#if __has_include(<ankerl/unordered_dense.h>)
+#include <ankerl/unordered_dense.h>
+#define HASH_MAP_BENCHMARK_ANKERL
+#endif
+
+#include "hash_functions.h"
+#include "hash_map_2.h"
+
+// Value of the large-value benchmarks, 256 bytes.
+struct LargeValue {
+    std::array<uint64_t, 32> words{};
+};
+
+// Key and value types of one set of benchmarks.
+struct IntegerKeys {
+    using Key = uint64_t;
+    using Value = uint64_t;
+    constexpr static const char* NAME = "uint64";
+};
+
+struct StringKeys {
+    using Key = std::string;
+    using Value = uint64_t;
+    constexpr static const char* NAME = "string";
+};
+
+struct LargeValues {
+    using Key = uint64_t;
+    using Value = LargeValue;
+    constexpr static const char* NAME = "large_value";
+};
+
+// Key made of a random number: the number itself or its 20-character text.
+template<class Key>
+Key make_key(uint64_t number);
+
+template<>
+uint64_t make_key<uint64_t>(uint64_t number) {
+    return number;
+}
+
+template<>
+std::string make_key<std::string>(uint64_t number) {
+    char text[21];
+    std::snprintf(text, sizeof(text), "key-%016llx", static_cast<unsigned long long>(number));
+    return text;
+}
+
+// What operator[] increment does with a value.
+inline void increment(uint64_t& value) {
+    value++;
+}
+
+inline void increment(LargeValue& value) {
+    value.words[0]++;
+}
+
+/* Zipf distributed ranks 0..n-1 with exponent theta, generator of Gray et al. as in YCSB:
+rank 0 is the most popular. Construction computes the zeta sum, Time: O(n). */
+class ZipfGenerator {
+ public:
+    ZipfGenerator(size_t n, double theta) : n_(n), theta_(theta) {
+        for (size_t i = 1; i <= n; i++) {
+            zeta_n_ += 1 / std::pow(static_cast<double>(i), theta);
+        }
+        double zeta_2 = 1 + 1 / std::pow(2.0, theta);
+        alpha_ = 1 / (1 - theta);
+        eta_ = (1 - std::pow(2.0 / n, 1 - theta)) / (1 - zeta_2 / zeta_n_);
+    }
+
+    template<class Random>
+    size_t operator()(Random& random) {
+        double u = std::uniform_real_distribution<double>(0, 1)(random);
+        double uz = u * zeta_n_;
+        if (uz < 1) {
+            return 0;
+        }
+        if (uz < 1 + std::pow(0.5, theta_)) {
+            return 1;
+        }
+        auto rank = static_cast<size_t>(n_ * std::pow(eta_ * u - eta_ + 1, alpha_));
+        return std::min(rank, n_ - 1);
+    }
+
+ private:
+    size_t n_;
+    double theta_;
+    double zeta_n_ = 0;
+    double alpha_ = 0;
+    double eta_ = 0;
+};
+
+enum class Distribution { UNIFORM, ZIPF };
+
+// Keys of one size: present keys in random order, absent keys and sequences of lookups.
+template<class Key>
+struct Dataset {
+    std::vector<Key> keys;
+    std::vector<Key> missing;
+    // Positions in keys, uniform and Zipf distributed.
+    std::vector<uint32_t> uniform;
+    std::vector<uint32_t> zipf;
+
+    const std::vector<uint32_t>& lookups(Distribution distribution) const {
+        return distribution == Distribution::UNIFORM ? uniform : zipf;
+    }
+};
+
+// Length of lookup sequences: large enough to miss the caches with the largest tables.
+constexpr size_t LOOKUP_COUNT = size_t(1) << 20;
+
+/* Dataset of n keys, only the last one of each key type is kept, so the largest sizes don't
+hold several copies. The same seed gives the same keys to all tables. */
+template<class Key>
+const Dataset<Key>& dataset(size_t n) {
+    static std::unique_ptr<Dataset<Key>> cached;
+    static size_t cached_n = 0;
+    if (cached && cached_n == n) {
+        return *cached;
+    }
+    cached.reset();
+    auto result = std::make_unique<Dataset<Key>>();
+    std::mt19937_64 random(n);
+    std::unordered_set<uint64_t> seen;
+    seen.reserve(2 * n);
+    while (result->keys.size() + result->missing.size() < 2 * n) {
+        uint64_t number = random();
+        if (seen.insert(number).second) {
+            (result->keys.size() < n ? result->keys : result->missing).push_back(
+                                            make_key<Key>(number));
+        }
+    }
+    std::uniform_int_distribution<uint32_t> position(0, static_cast<uint32_t>(n - 1));
+    ZipfGenerator zipf(n, 0.99);
+    for (size_t i = 0; i < LOOKUP_COUNT; i++) {
+        result->uniform.push_back(position(random));
+        result->zipf.push_back(static_cast<uint32_t>(zipf(random)));
+    }
+    cached = std::move(result);
+    cached_n = n;
+    return *cached;
+}
+
+template<class Table, class Key>
+void fill(Table& table, const Dataset<Key>& data) {
+    for (auto& key : data.keys) {
+        table.insert({key, {}});
+    }
+}
+
+// n inserts into a new table, that grows from the start. Destruction is not timed.
+template<class Table, class Key>
+void insert_benchmark(benchmark::State& state, size_t n) {
+    auto& data = dataset<Key>(n);
+    for (auto _ : state) {
+        auto table = std::make_unique<Table>();
+        fill(*table, data);
+        benchmark::DoNotOptimize(table->size());
+        state.PauseTiming();
+        table.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+// Lookups of present keys taken by the distribution.
+template<class Table, class Key>
+void hit_benchmark(benchmark::State& state, size_t n, Distribution distribution) {
+    auto& data = dataset<Key>(n);
+    Table table;
+    fill(table, data);
+    auto& lookups = data.lookups(distribution);
+    size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.find(data.keys[lookups[next]]) != table.end());
+        next = (next + 1 == lookups.size()) ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Lookups of absent keys.
+template<class Table, class Key>
+void miss_benchmark(benchmark::State& state, size_t n) {
+    auto& data = dataset<Key>(n);
+    Table table;
+    fill(table, data);
+    size_t next = 0;
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(table.find(data.missing[next]) != table.end());
+        next = (next + 1 == data.missing.size()) ? 0 : next + 1;
+    }
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Erases all keys in random order from a copy of the full table. The copy is not timed.
+template<class Table, class Key>
+void erase_benchmark(benchmark::State& state, size_t n) {
+    auto& data = dataset<Key>(n);
+    Table full;
+    fill(full, data);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto table = std::make_unique<Table>(full);
+        state.ResumeTiming();
+        for (auto& key : data.keys) {
+            benchmark::DoNotOptimize(table->erase(key));
+        }
+        state.PauseTiming();
+        table.reset();
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+// Sum over all values, one element is an item.
+template<class Table, class Key>
+void iteration_benchmark(benchmark::State& state, size_t n) {
+    auto& data = dataset<Key>(n);
+    Table table;
+    fill(table, data);
+    for (auto _ : state) {
+        for (auto&& element : table) {
+            benchmark::DoNotOptimize(&element.second);
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * n);
+}
+
+// ++table[key] for present keys taken by the distribution, as counters do.
+template<class Table, class Key>
+void increment_benchmark(benchmark::State& state, size_t n, Distribution distribution) {
+    auto& data = dataset<Key>(n);
+    Table table;
+    fill(table, data);
+    auto& lookups = data.lookups(distribution);
+    size_t next = 0;
+    for (auto _ : state) {
+        increment(table[data.keys[lookups[next]]]);
+        next = (next + 1 == lookups.size()) ? 0 : next + 1;
+    }
+    benchmark::DoNotOptimize(table.size());
+    state.SetItemsProcessed(state.iterations());
+}
+
+// Rehash to twice the buckets and back to the smallest count, one element is an item.
+template<class Table, class Key>
+void rehash_benchmark(benchmark::State& state, size_t n) {
+    auto& data = dataset<Key>(n);
+    Table table;
+    fill(table, data);
+    for (auto _ : state) {
+        table.rehash(2 * table.bucket_count());
+        table.rehash(0);
+    }
+    state.SetItemsProcessed(state.iterations() * 2 * n);
+}
+
+const char* distribution_name(Distribution distribution) {
+    return distribution == Distribution::UNIFORM ? "uniform" : "zipf";
+}
+
+// Registers all operations for one table and key type at one size.
+template<class Types, template<class, class> class Table>
+void register_table(const char* table_name, size_t n) {
+    using Key = typename Types::Key;
+    using Map = Table<Key, typename Types::Value>;
+    auto name = [&](const char* operation, const char* distribution) {
+        return std::string(operation) + "/" + table_name + "/" + Types::NAME + "/" +
+                    distribution + "/" + std::to_string(n);
+    };
+    benchmark::RegisterBenchmark(name("insert", "-").c_str(), [n](benchmark::State& state) {
+        insert_benchmark<Map, Key>(state, n);
+    });
+    for (Distribution distribution : {Distribution::UNIFORM, Distribution::ZIPF}) {
+        benchmark::RegisterBenchmark(name("hit", distribution_name(distribution)).c_str(),
+                                     [n, distribution](benchmark::State& state) {
+            hit_benchmark<Map, Key>(state, n, distribution);
+        });
+    }
+    benchmark::RegisterBenchmark(name("miss", "uniform").c_str(), [n](benchmark::State& state) {
+        miss_benchmark<Map, Key>(state, n);
+    });
+    benchmark::RegisterBenchmark(name("erase", "-").c_str(), [n](benchmark::State& state) {
+        erase_benchmark<Map, Key>(state, n);
+    });
+    benchmark::RegisterBenchmark(name("iteration", "-").c_str(), [n](benchmark::State& state) {
+        iteration_benchmark<Map, Key>(state, n);
+    });
+    for (Distribution distribution : {Distribution::UNIFORM, Distribution::ZIPF}) {
+        benchmark::RegisterBenchmark(name("increment", distribution_name(distribution)).c_str(),
+                                     [n, distribution](benchmark::State& state) {
+            increment_benchmark<Map, Key>(state, n, distribution);
+        });
+    }
+    benchmark::RegisterBenchmark(name("rehash", "-").c_str(), [n](benchmark::State& state) {
+        rehash_benchmark<Map, Key>(state, n);
+    });
+}
+
+// Tables under test. HashMap gets WyHash, with identity std::hash power of two sizing is slow.
+template<class Key, class Value>
+using StdUnorderedMap = std::unordered_map<Key, Value>;
+
+template<class Key, class Value>
+using ChainedHashMap = HashMap<Key, Value, WyHash<Key>, std::equal_to<Key>,
+                               std::allocator<std::pair<const Key, Value>>, ChainedIndex<>>;
+
+template<class Key, class Value>
+using OpenAddressingHashMap = HashMap<Key, Value, WyHash<Key>, std::equal_to<Key>,
+                                      std::allocator<std::pair<const Key, Value>>,
+                                      OpenAddressingIndex<PowerOfTwoSizing>>;
+
+template<class Key, class Value>
+using GroupProbingHashMap = HashMap<Key, Value, WyHash<Key>, std::equal_to<Key>,
+                                    std::allocator<std::pair<const Key, Value>>,
+                                    GroupProbingIndex<PowerOfTwoSizing>, true>;
+
+#if defined(HASH_MAP_BENCHMARK_ABSL)
+template<class Key, class Value>
+using AbslFlatHashMap = absl::flat_hash_map<Key, Value>;
+#endif
+
+#if defined(HASH_MAP_BENCHMARK_ANKERL)
+template<class Key, class Value>
+using AnkerlUnorderedDense = ankerl::unordered_dense::map<Key, Value>;
+#endif
+
+// Cache size in bytes by level (0 is the last level), fallback values without cache info.
+size_t cache_size(int level) {
+    int largest_level = 0;
+    size_t size = 0;
+    for (auto& cache : benchmark::CPUInfo::Get().caches) {
+        if (cache.type == "Instruction") {
+            continue;
+        }
+        if (cache.level == level || (level == 0 && cache.level > largest_level)) {
+            largest_level = cache.level;
+            size = static_cast<size_t>(cache.size);
+        }
+    }
+    if (size != 0) {
+        return size;
+    }
+    return level == 1 ? (32 << 10) : level == 2 ? (1 << 20) : (32 << 20);
+}
+
+/* Element counts, whose tables take about half of L1, of L2, of the last level cache and
+10 times it. bytes is the approximate size of one element with its index entry. */
+std::vector<size_t> table_sizes(size_t bytes, size_t max_elements) {
+    std::vector<size_t> sizes;
+    for (size_t cache_bytes : {cache_size(1) / 2, cache_size(2) / 2, cache_size(0) / 2,
+                               cache_size(0) * 10}) {
+        size_t n = std::max<size_t>(cache_bytes / bytes, 16);
+        if (n <= max_elements && (sizes.empty() || n > sizes.back())) {
+            sizes.push_back(n);
+        }
+    }
+    return sizes;
+}
+
+template<class Types>
+void register_types(size_t max_elements) {
+    using Element = std::pair<typename Types::Key, typename Types::Value>;
+    for (size_t n : table_sizes(sizeof(Element) + 16, max_elements)) {
+        register_table<Types, StdUnorderedMap>("std::unordered_map", n);
+        register_table<Types, ChainedHashMap>("HashMap<Chained>", n);
+        register_table<Types, OpenAddressingHashMap>("HashMap<OpenAddressing>", n);
+        register_table<Types, GroupProbingHashMap>("HashMap<GroupProbing>", n);
+#if defined(HASH_MAP_BENCHMARK_ABSL)
+        register_table<Types, AbslFlatHashMap>("absl::flat_hash_map", n);
+#endif
+#if defined(HASH_MAP_BENCHMARK_ANKERL)
+        register_table<Types, AnkerlUnorderedDense>("ankerl::unordered_dense", n);
+#endif
+    }
+}
+
+int main(int argc, char** argv) {
+    benchmark::Initialize(&argc, argv);
+    size_t max_elements = static_cast<size_t>(-1);
+    const char* flag = "--max_elements=";
+    for (int i = 1; i < argc; i++) {
+        if (std::strncmp(argv[i], flag, std::strlen(flag)) == 0) {
+            max_elements = std::stoull(argv[i] + std::strlen(flag));
+            std::copy(argv + i + 1, argv + argc, argv + i);
+            argc--;
+            i--;
+        }
+    }
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return 1;
+    }
+    benchmark::AddCustomContext("L1", std::to_string(cache_size(1)));
+    benchmark::AddCustomContext("L2", std::to_string(cache_size(2)));
+    benchmark::AddCustomContext("LLC", std::to_string(cache_size(0)));
+    register_types<IntegerKeys>(max_elements);
+    register_types<StringKeys>(max_elements);
+    register_types<LargeValues>(max_elements);
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,324 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#ifndef HASH_MULTI_MAP_H_
+#define HASH_MULTI_MAP_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "hash_map_2.h"
+
+/* Hash table with many values for one key (posting lists, adjacency lists). Every key is kept
+once in HashMap keys_ (with any index, sizing and storage policies), all values of the key are
+one run of consecutive slots in values_. So equal_range is a range of pointers, reading the k
+values of a key touches k adjacent slots, and there is no heap vector per key.
+A run has a power of two slots. A full run grows in place if it is the last one in values_,
+otherwise it moves to the end of values_ with twice the slots, and its old slots become
+garbage. When garbage is more than a half of values_, all runs are packed together again, so
+inserts are amortized O(1) and values_ is at most about four times the number of values.
+Values of a key are kept in the order of insertion. ValueType must be default constructible:
+free slots hold ValueType(). Any insert or erase may move values, pointers of equal_range
+become invalid after the next change of the table. */
+template<class KeyType, class ValueType, class Hash = std::hash<KeyType>,
+                            class KeyEqual = std::equal_to<KeyType>,
+                            class Allocator = std::allocator<std::pair<const KeyType, ValueType>>,
+                            class IndexPolicy = ChainedIndex<>,
+                            bool CacheHash = false,
+                            class StoragePolicy = PairStorage>
+class HashMultiMap {
+    // Slots of one key in values_: size values from begin, capacity slots are reserved.
+    struct Run {
+        size_t begin = 0;
+        size_t size = 0;
+        size_t capacity = 0;
+    };
+
+    using RunAllocator = typename std::allocator_traits<Allocator>::template
+                                    rebind_alloc<std::pair<const KeyType, Run>>;
+    using ValueAllocator = typename std::allocator_traits<Allocator>::template
+                                    rebind_alloc<ValueType>;
+    using Keys = HashMap<KeyType, Run, Hash, KeyEqual, RunAllocator, IndexPolicy, CacheHash,
+                         StoragePolicy>;
+
+ public:
+    using allocator_type = Allocator;
+    using value_range = IteratorRange<ValueType*>;
+    using const_value_range = IteratorRange<const ValueType*>;
+
+    // Creates empty table, nothing is allocated. Time: O(1).
+    HashMultiMap(const Hash& hasher = Hash(), const KeyEqual& key_equal = KeyEqual(),
+                 const Allocator& allocator = Allocator()) :
+                        keys_(hasher, key_equal, RunAllocator(allocator)),
+                        values_(ValueAllocator(allocator)),
+                        size_(0),
+                        garbage_(0) {}
+
+    /* Creates table of the pairs, values of equal keys keep the order of the list.
+    Time: expected O(quantity of pairs). */
+    HashMultiMap(std::initializer_list<std::pair<KeyType, ValueType>> init_list,
+                 const Hash& hasher = Hash(), const KeyEqual& key_equal = KeyEqual(),
+                 const Allocator& allocator = Allocator()) :
+                        HashMultiMap(hasher, key_equal, allocator) {
+        for (const auto& elem : init_list) {
+            insert(elem);
+        }
+    }
+
+    // Number of values of all keys. Time: O(1).
+    size_t size() const {
+        return size_;
+    }
+
+    // Number of different keys. Time: O(1).
+    size_t key_count() const {
+        return keys_.size();
+    }
+
+    // Time: O(1).
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Range over all keys, every key is there once. Time: O(1).
+    auto keys() const {
+        return keys_.keys();
+    }
+
+    /* Adds the value to the values of the key, after them. Returns reference to the new
+    value. Time: expected and amortized O(1). */
+    ValueType& insert(const std::pair<KeyType, ValueType>& key_value) {
+        return emplace(key_value.first, key_value.second);
+    }
+
+    // The same as insert above, but the pair is moved into the table.
+    ValueType& insert(std::pair<KeyType, ValueType>&& key_value) {
+        return emplace(std::move(key_value.first), std::move(key_value.second));
+    }
+
+    /* Adds the value constructed from args to the values of the key. The key is moved only
+    if it is new. Time: expected and amortized O(1). */
+    template<class... Args>
+    ValueType& emplace(const KeyType& key, Args&&... args) {
+        return append(key, std::forward<Args>(args)...);
+    }
+
+    template<class... Args>
+    ValueType& emplace(KeyType&& key, Args&&... args) {
+        return append(std::move(key), std::forward<Args>(args)...);
+    }
+
+    // Values of the key in the order of insertion, empty range if there is no such key.
+    // Time: expected O(1).
+    value_range equal_range(const KeyType& key) {
+        auto position = keys_.find(key);
+        if (position == keys_.end()) {
+            return {};
+        }
+        const Run& run = position->second;
+        return {values_.data() + run.begin, values_.data() + run.begin + run.size};
+    }
+
+    // Constant values of the key. Time: expected O(1).
+    const_value_range equal_range(const KeyType& key) const {
+        auto position = keys_.find(key);
+        if (position == keys_.end()) {
+            return {};
+        }
+        const Run& run = position->second;
+        return {values_.data() + run.begin, values_.data() + run.begin + run.size};
+    }
+
+    // Number of values of the key. Time: expected O(1).
+    size_t count(const KeyType& key) const {
+        auto position = keys_.find(key);
+        return (position == keys_.end()) ? 0 : position->second.size;
+    }
+
+    // Time: expected O(1).
+    bool contains(const KeyType& key) const {
+        return keys_.contains(key);
+    }
+
+    /* Calls function(key, const_value_range) for every key, in the order of keys().
+    Time: O(quantity of values). */
+    template<class Function>
+    void for_each(Function function) const {
+        for (const auto& element : keys_) {
+            const Run& run = element.second;
+            function(element.first, const_value_range(values_.data() + run.begin,
+                                                      values_.data() + run.begin + run.size));
+        }
+    }
+
+    // Removes the key with all its values, returns number of values. Time: expected O(matches).
+    size_t erase(const KeyType& key) {
+        auto position = keys_.find(key);
+        if (position == keys_.end()) {
+            return 0;
+        }
+        Run run = position->second;
+        keys_.erase(position);
+        release(run);
+        size_ -= run.size;
+        return run.size;
+    }
+
+    /* Removes values of the key, that satisfy the predicate, the others keep their order. The
+    key is removed with its last value. Returns number of removed values.
+    Time: expected O(matches). */
+    template<class Predicate>
+    size_t erase_if(const KeyType& key, Predicate predicate) {
+        auto position = keys_.find(key);
+        if (position == keys_.end()) {
+            return 0;
+        }
+        Run& run = position->second;
+        ValueType* first = values_.data() + run.begin;
+        ValueType* kept = std::remove_if(first, first + run.size, predicate);
+        size_t removed = first + run.size - kept;
+        std::fill(kept, first + run.size, ValueType());
+        run.size -= removed;
+        size_ -= removed;
+        if (run.size == 0) {
+            Run empty_run = run;
+            keys_.erase(position);
+            release(empty_run);
+        }
+        return removed;
+    }
+
+    /* Reserves place for key_count keys and value_count values, so inserts don't reallocate
+    until then (a run may still move). Time: O(key_count + value_count). */
+    void reserve(size_t key_count, size_t value_count) {
+        keys_.reserve(key_count);
+        values_.reserve(value_count);
+    }
+
+    // Removes all values and frees memory. Time: O(quantity of values).
+    void clear() {
+        keys_.clear();
+        values_ = std::vector<ValueType, ValueAllocator>(values_.get_allocator());
+        size_ = 0;
+        garbage_ = 0;
+    }
+
+    /* Packs runs together and takes the smallest power of two slots for each run, then frees
+    unused memory. Time: O(quantity of values). */
+    void shrink_to_fit() {
+        pack(true);
+        values_.shrink_to_fit();
+        keys_.shrink_to_fit();
+    }
+
+    // Time: O(1).
+    Allocator get_allocator() const {
+        return Allocator(values_.get_allocator());
+    }
+
+ private:
+    Keys keys_;
+    std::vector<ValueType, ValueAllocator> values_;
+    // Number of values.
+    size_t size_;
+    // Number of slots in values_, that belong to no run.
+    size_t garbage_;
+
+    // The smallest power of two, that is not less than count and not less than 1. Time: O(log).
+    static size_t run_capacity(size_t count) {
+        size_t capacity = 1;
+        while (capacity < count) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    /* The value is constructed before the key is looked up, so a throwing constructor
+    leaves no key without values. Time: expected and amortized O(1). */
+    template<class Key, class... Args>
+    ValueType& append(Key&& key, Args&&... args) {
+        ValueType value(std::forward<Args>(args)...);
+        Run& run = keys_[std::forward<Key>(key)];
+        if (run.size == run.capacity) {
+            grow(run);
+        }
+        ValueType& slot = values_[run.begin + run.size];
+        slot = std::move(value);
+        run.size++;
+        size_++;
+        return slot;
+    }
+
+    /* Doubles slots of the full run: in place for the last run of values_, or by move to the
+    end. Packs all runs if garbage becomes more than a half. Time: amortized O(run.size). */
+    void grow(Run& run) {
+        size_t capacity = std::max<size_t>(2 * run.capacity, 1);
+        if (run.capacity == 0 || run.begin + run.capacity == values_.size()) {
+            size_t begin = values_.size() - run.capacity;
+            values_.resize(begin + capacity);
+            run.begin = begin;
+            run.capacity = capacity;
+            return;
+        }
+        size_t begin = values_.size();
+        values_.resize(begin + capacity);
+        for (size_t i = 0; i < run.size; i++) {
+            values_[begin + i] = std::move(values_[run.begin + i]);
+            values_[run.begin + i] = ValueType();
+        }
+        garbage_ += run.capacity;
+        run.begin = begin;
+        run.capacity = capacity;
+        if (2 * garbage_ > values_.size()) {
+            pack(false);
+        }
+    }
+
+    // Frees slots of the removed run: the end of values_ is cut, other slots become garbage.
+    void release(const Run& run) {
+        if (run.begin + run.capacity == values_.size()) {
+            values_.resize(run.begin);
+        } else {
+            std::fill(values_.begin() + run.begin, values_.begin() + run.begin + run.size,
+                      ValueType());
+            garbage_ += run.capacity;
+            if (2 * garbage_ > values_.size()) {
+                pack(false);
+            }
+        }
+    }
+
+    /* Moves all runs into new array in the order of keys_, shrink = true also cuts the
+    capacity of every run to the smallest power of two. The runs are changed only after all
+    values are moved, so an exception leaves the table as it was. Time: O(values_.size()). */
+    void pack(bool shrink) {
+        std::vector<ValueType, ValueAllocator> packed(values_.get_allocator());
+        size_t slots = 0;
+        for (const Run& run : keys_.values()) {
+            slots += shrink ? run_capacity(run.size) : run.capacity;
+        }
+        packed.reserve(slots);
+        for (const Run& run : keys_.values()) {
+            size_t begin = packed.size();
+            for (size_t i = 0; i < run.size; i++) {
+                packed.push_back(std::move_if_noexcept(values_[run.begin + i]));
+            }
+            packed.resize(begin + (shrink ? run_capacity(run.size) : run.capacity));
+        }
+        size_t begin = 0;
+        for (Run& run : keys_.values()) {
+            run.begin = begin;
+            if (shrink) {
+                run.capacity = run_capacity(run.size);
+            }
+            begin += run.capacity;
+        }
+        values_ = std::move(packed);
+        garbage_ = 0;
+    }
+};
+
+#endif  // HASH_MULTI_MAP_H_
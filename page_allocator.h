@@ -0,0 +1,206 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#ifndef PAGE_ALLOCATOR_H_
+#define PAGE_ALLOCATOR_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <new>
+#include <string>
+#include <type_traits>
+
+#if defined(__linux__)
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/* Page sizes of PageAllocator. TRANSPARENT maps ordinary pages aligned to 2MB and asks the
+kernel with madvise(MADV_HUGEPAGE) to back them with transparent huge pages. RESERVED_2MB and
+RESERVED_1GB take pages of the hugetlbfs pool (MAP_HUGETLB), that the administrator reserves
+in /proc/sys/vm/nr_hugepages or at boot, and fall back to TRANSPARENT if the pool is empty.
+NONE maps ordinary pages, that is only good for NUMA placement. */
+enum class HugePages {
+    NONE,
+    TRANSPARENT,
+    RESERVED_2MB,
+    RESERVED_1GB
+};
+
+// Node of PageAllocator that means no NUMA placement: pages come from where they are touched.
+constexpr int ANY_NUMA_NODE = -1;
+
+/* Number of NUMA nodes of the machine (the highest online node + 1), 1 if it is not NUMA or
+not Linux. Time: O(1), reads /sys once per call. */
+inline int numa_node_count() {
+    std::ifstream online("/sys/devices/system/node/online");
+    std::string nodes;
+    if (!(online >> nodes) || nodes.empty()) {
+        return 1;
+    }
+    // The list looks like "0" or "0-3" or "0,2-3", the last number is the highest node.
+    size_t last = nodes.find_last_of(",-");
+    return std::stoi(last == std::string::npos ? nodes : nodes.substr(last + 1)) + 1;
+}
+
+/* Allocator for very large tables: blocks of at least MAPPED_BYTES are mapped with mmap on
+huge pages (see HugePages) and, if node is given, bound to that NUMA node with mbind, so one
+TLB entry covers 2MB or 1GB of value_store_ or the index instead of 4KB, and threads of that
+node read local memory. Smaller blocks (buckets of ChainedIndex, small tables) come from
+operator new, the mapping would waste most of a huge page. HashMap takes all its memory
+from the allocator, so with a flat index (OpenAddressingIndex, GroupProbingIndex) the whole
+table is on huge pages:
+    HashMap<uint64_t, Session, WyHash<uint64_t>, std::equal_to<uint64_t>,
+            PageAllocator<std::pair<const uint64_t, Session>>, GroupProbingIndex<>> table;
+ConcurrentHashMap places every shard on its own node with the shard allocator constructor.
+Placement is a hint: without NUMA support (or outside Linux) memory comes from any node, and
+without Linux every block comes from operator new. The allocator propagates with the table
+on copy, move and swap, so a moved table keeps its placement. mmap failure throws bad_alloc. */
+template<class T>
+class PageAllocator {
+ public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    // Smaller blocks come from operator new.
+    constexpr static size_t MAPPED_BYTES = static_cast<size_t>(1) << 20;
+
+    explicit PageAllocator(HugePages huge_pages = HugePages::TRANSPARENT,
+                           int node = ANY_NUMA_NODE) noexcept :
+                        huge_pages_(huge_pages), node_(node) {}
+
+    template<class U>
+    PageAllocator(const PageAllocator<U>& other) noexcept :
+                        huge_pages_(other.huge_pages()), node_(other.node()) {}
+
+    // Time: O(1), pages are not touched.
+    T* allocate(size_t count) {
+        if (count > SIZE_MAX / sizeof(T)) {
+            throw std::bad_alloc();
+        }
+        size_t bytes = count * sizeof(T);
+#if defined(__linux__)
+        if (bytes >= MAPPED_BYTES) {
+            return static_cast<T*>(map(mapping_length(bytes)));
+        }
+#endif
+        return static_cast<T*>(::operator new(bytes, std::align_val_t(alignof(T))));
+    }
+
+    // Time: O(1).
+    void deallocate(T* pointer, size_t count) noexcept {
+        size_t bytes = count * sizeof(T);
+#if defined(__linux__)
+        if (bytes >= MAPPED_BYTES) {
+            ::munmap(pointer, mapping_length(bytes));
+            return;
+        }
+#endif
+        ::operator delete(pointer, std::align_val_t(alignof(T)));
+    }
+
+    HugePages huge_pages() const noexcept {
+        return huge_pages_;
+    }
+
+    int node() const noexcept {
+        return node_;
+    }
+
+    // Memory of one allocator can be freed by another with the same placement.
+    template<class U>
+    bool operator==(const PageAllocator<U>& other) const noexcept {
+        return huge_pages_ == other.huge_pages() && node_ == other.node();
+    }
+
+    template<class U>
+    bool operator!=(const PageAllocator<U>& other) const noexcept {
+        return !(*this == other);
+    }
+
+ private:
+    constexpr static size_t PAGE_2MB_ = static_cast<size_t>(1) << 21;
+    constexpr static size_t PAGE_1GB_ = static_cast<size_t>(1) << 30;
+    constexpr static size_t MAX_NUMA_NODES_ = 1024;
+
+    HugePages huge_pages_;
+    int node_;
+
+    /* Length of the mapping of bytes: whole pages of the chosen size, so munmap gets the same
+    length that mmap did, even after a fallback. Time: O(1). */
+    size_t mapping_length(size_t bytes) const {
+        size_t page = (huge_pages_ == HugePages::RESERVED_1GB) ? PAGE_1GB_ : PAGE_2MB_;
+        return (bytes + page - 1) / page * page;
+    }
+
+#if defined(__linux__)
+    // Maps length bytes as described in the class comment. Time: O(1).
+    void* map(size_t length) const {
+        void* address = MAP_FAILED;
+#if defined(MAP_HUGETLB)
+        if (huge_pages_ == HugePages::RESERVED_2MB || huge_pages_ == HugePages::RESERVED_1GB) {
+            // Bits 26..31 of the flags are log2 of the huge page size (MAP_HUGE_2MB, MAP_HUGE_1GB).
+            int size_bits = (huge_pages_ == HugePages::RESERVED_1GB) ? 30 : 21;
+            address = ::mmap(nullptr, length, PROT_READ | PROT_WRITE,
+                             MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | (size_bits << 26),
+                             -1, 0);
+        }
+#endif
+        if (address == MAP_FAILED) {
+            address = map_aligned(length);
+        }
+        bind(address, length);
+        return address;
+    }
+
+    /* Maps ordinary pages at a 2MB boundary (transparent huge pages need aligned 2MB ranges),
+    the extra head and tail of the bigger mapping are unmapped. Time: O(1). */
+    void* map_aligned(size_t length) const {
+        size_t mapped = length + PAGE_2MB_;
+        void* address = ::mmap(nullptr, mapped, PROT_READ | PROT_WRITE,
+                               MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (address == MAP_FAILED) {
+            throw std::bad_alloc();
+        }
+        uintptr_t begin = reinterpret_cast<uintptr_t>(address);
+        uintptr_t aligned = (begin + PAGE_2MB_ - 1) / PAGE_2MB_ * PAGE_2MB_;
+        if (aligned != begin) {
+            ::munmap(address, aligned - begin);
+        }
+        size_t tail = mapped - (aligned - begin) - length;
+        if (tail != 0) {
+            ::munmap(reinterpret_cast<void*>(aligned + length), tail);
+        }
+#if defined(MADV_HUGEPAGE)
+        if (huge_pages_ != HugePages::NONE) {
+            ::madvise(reinterpret_cast<void*>(aligned), length, MADV_HUGEPAGE);
+        }
+#endif
+        return reinterpret_cast<void*>(aligned);
+    }
+
+    /* Binds the mapping to node_ with the preferred policy, so pages still come from other
+    nodes when node_ is full. Errors (no NUMA in the kernel) are ignored. Time: O(1). */
+    void bind(void* address, size_t length) const {
+#if defined(SYS_mbind)
+        // MPOL_PREFERRED of <numaif.h>, that is not needed for one constant.
+        const int preferred_policy = 1;
+        const size_t word_bits = 8 * sizeof(unsigned long);
+        unsigned long mask[MAX_NUMA_NODES_ / word_bits] = {};
+        if (node_ < 0 || static_cast<size_t>(node_) >= MAX_NUMA_NODES_) {
+            return;
+        }
+        mask[node_ / word_bits] |= 1UL << (node_ % word_bits);
+        // The kernel reads one bit less than maxnode.
+        ::syscall(SYS_mbind, address, length, preferred_policy, mask, MAX_NUMA_NODES_ + 1, 0);
+#else
+        (void)address;
+        (void)length;
+#endif
+    }
+#endif
+};
+
+#endif  // PAGE_ALLOCATOR_H_
@@ -0,0 +1,230 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#ifndef READ_MOSTLY_HASH_MAP_H_
+#define READ_MOSTLY_HASH_MAP_H_
+
+#include <atomic>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+#include "hash_map_2.h"
+
+/* This class is hash table for tables that are read much more often than written
+(configs, routing tables). Readers take no locks and never wait: a lookup is a fixed number
+of atomic operations and search in the current version of the table. The current version is
+immutable HashMap behind atomic pointer. Writers are serialized by a mutex, build the next
+version on the side (copy of the current one with the changes applied, so growth of
+value_store_ and the index happens there too), publish it with one atomic store and free the
+old version after a grace period, like RCU does.
+
+Grace period: a reader announces itself in one of two reader counters (by parity of epoch_),
+then loads the pointer. Writer, after publishing, flips the epoch and waits until readers of
+the old parity leave, then flips again and waits for the other parity. Every reader that could
+have loaded the old pointer had announced itself before the store, so it is waited for, and new
+readers go to the other counter, so the writer is not starved. Counters are spread over cache
+lines by thread, so readers of different threads don't bounce one line.
+
+Every write copies the whole table: Time: O(quantity of elements in the table). Use write() to
+apply many changes at once. */
+template<class KeyType, class ValueType, class Hash = std::hash<KeyType>,
+                            class KeyEqual = std::equal_to<KeyType>,
+                            class Allocator = std::allocator<std::pair<const KeyType, ValueType>>,
+                            class IndexPolicy = ChainedIndex<>,
+                            bool CacheHash = false,
+                            class StoragePolicy = PairStorage,
+                            class StatsPolicy = NoStats>
+class ReadMostlyHashMap {
+ public:
+    using Map = HashMap<KeyType, ValueType, Hash, KeyEqual, Allocator, IndexPolicy, CacheHash,
+                        StoragePolicy, StatsPolicy>;
+
+    // Creates empty table. Time: O(1).
+    explicit ReadMostlyHashMap(const Hash& hasher = Hash(),
+                               const KeyEqual& key_equal = KeyEqual(),
+                               const Allocator& allocator = Allocator()) :
+                        current_(new Map(hasher, key_equal, allocator)) {}
+
+    // Creates table from initializer list. Time: O(quantity of elements in table).
+    ReadMostlyHashMap(std::initializer_list<std::pair<KeyType, ValueType>> init_list,
+                      const Hash& hasher = Hash(),
+                      const KeyEqual& key_equal = KeyEqual(),
+                      const Allocator& allocator = Allocator()) :
+                        current_(new Map(init_list, hasher, key_equal, allocator)) {}
+
+    ReadMostlyHashMap(const ReadMostlyHashMap&) = delete;
+    ReadMostlyHashMap& operator=(const ReadMostlyHashMap&) = delete;
+
+    // There must be no readers and writers left. Time: O(quantity of elements in the table).
+    ~ReadMostlyHashMap() {
+        delete current_.load();
+    }
+
+    // Wait-free. Time: O(1).
+    size_t size() const {
+        ReadSection section(*this);
+        return section.map().size();
+    }
+
+    // Wait-free. Time: O(1).
+    bool empty() const {
+        return size() == 0;
+    }
+
+    /* Stats of the current version. A write copies counters into the next version, lookups
+    made in the old one while the write runs are not counted. Wait-free.
+    Time: O(bucket_count). */
+    HashMapStats stats() const {
+        ReadSection section(*this);
+        return section.map().stats();
+    }
+
+    // Wait-free. Time: expected O(1).
+    bool contains(const KeyType& key) const {
+        ReadSection section(*this);
+        return section.map().contains(key);
+    }
+
+    /* Copies the value of the key into value and returns true if the key is in
+    the table. Wait-free. Time: expected O(1). */
+    bool find(const KeyType& key, ValueType& value) const {
+        ReadSection section(*this);
+        auto iter = section.map().find(key);
+        if (iter == section.map().end()) {
+            return false;
+        }
+        value = iter->second;
+        return true;
+    }
+
+    /* Returns copy of the value if this key is in the table. Throws out_of_range
+    exception otherwise. Wait-free. Time: expected O(1). */
+    ValueType at(const KeyType& key) const {
+        ReadSection section(*this);
+        return section.map().at(key);
+    }
+
+    /* Calls function(const Map&) with the current version of the table and returns
+    its result. The version stays alive until the function returns, so it can be scanned
+    or searched many times consistently. Function must not write to this table. */
+    template<class Function>
+    auto read(Function function) const {
+        ReadSection section(*this);
+        return function(section.map());
+    }
+
+    /* Applies function(Map&) to the copy of the current version and publishes it.
+    Time: O(quantity of elements in the table) + time of the function + grace period. */
+    template<class Function>
+    void write(Function function) {
+        std::lock_guard<std::mutex> lock(writer_mutex_);
+        const Map* old_version = current_.load();
+        std::unique_ptr<Map> next_version(new Map(*old_version));
+        function(*next_version);
+        current_.store(next_version.release());
+        synchronize();
+        delete old_version;
+    }
+
+    // Inserts element if there was no such key, returns true if it was inserted.
+    bool insert(const std::pair<KeyType, ValueType>& key_value) {
+        bool inserted = false;
+        write([&](Map& map) {
+            inserted = map.insert(key_value).second;
+        });
+        return inserted;
+    }
+
+    // Inserts the value or assigns it to the existing element.
+    void insert_or_assign(const KeyType& key, const ValueType& value) {
+        write([&](Map& map) {
+            map.insert_or_assign(key, value);
+        });
+    }
+
+    // Removes the key, returns number of removed elements (0 or 1).
+    size_t erase(const KeyType& key) {
+        size_t erased = 0;
+        write([&](Map& map) {
+            erased = map.erase(key);
+        });
+        return erased;
+    }
+
+    // Replaces the table with empty one.
+    void clear() {
+        write([](Map& map) {
+            map.clear();
+        });
+    }
+
+ private:
+    struct alignas(64) ReaderCounter {
+        std::atomic<size_t> active{0};
+    };
+
+    // Marks the thread as reader of the current version while the object lives.
+    class ReadSection {
+     public:
+        explicit ReadSection(const ReadMostlyHashMap& owner) :
+                counter_(owner.readers_[owner.epoch_.load() & 1][reader_slot()]) {
+            counter_.active.fetch_add(1);
+            map_ = owner.current_.load();
+        }
+
+        ~ReadSection() {
+            counter_.active.fetch_sub(1);
+        }
+
+        ReadSection(const ReadSection&) = delete;
+        ReadSection& operator=(const ReadSection&) = delete;
+
+        const Map& map() const {
+            return *map_;
+        }
+
+     private:
+        ReaderCounter& counter_;
+        const Map* map_ = nullptr;
+    };
+
+    constexpr static size_t READER_SLOTS_ = 64;
+
+    std::atomic<const Map*> current_;
+    std::atomic<size_t> epoch_{0};
+    mutable ReaderCounter readers_[2][READER_SLOTS_];
+    std::mutex writer_mutex_;
+
+    // Every thread always uses the same counter slot.
+    static size_t reader_slot() {
+        static thread_local const size_t slot =
+                std::hash<std::thread::id>()(std::this_thread::get_id()) % READER_SLOTS_;
+        return slot;
+    }
+
+    /* Waits until every reader, that could see the previous version, has left.
+    Called by the writer after the store of the new version. */
+    void synchronize() {
+        for (size_t phase = 0; phase < 2; phase++) {
+            size_t parity = epoch_.fetch_add(1) & 1;
+            for (auto& counter : readers_[parity]) {
+                while (counter.active.load() != 0) {
+                    std::this_thread::yield();
+                }
+            }
+        }
+    }
+};
+
+// Threading policy of HashMapPolicies: ReadMostlyHashMap with wait-free readers.
+struct ReadCopyUpdate {
+    template<class KeyType, class ValueType, class Hash, class KeyEqual, class Allocator,
+             class IndexPolicy, bool CacheHash, class StoragePolicy, class StatsPolicy>
+    using map = ReadMostlyHashMap<KeyType, ValueType, Hash, KeyEqual, Allocator, IndexPolicy,
+                                  CacheHash, StoragePolicy, StatsPolicy>;
+};
+
+#endif  // READ_MOSTLY_HASH_MAP_H_
@@ -0,0 +1,164 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#ifndef STATIC_HASH_MAP_H_
+#define STATIC_HASH_MAP_H_
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+
+/* Hash functions, that can be computed at compile time (std::hash can't).
+Integers and enums are mixed with splitmix64 finalizer, strings are hashed with FNV-1a. */
+template<class KeyType, class = void>
+struct ConstexprHash;
+
+template<class KeyType>
+struct ConstexprHash<KeyType, typename std::enable_if<std::is_integral<KeyType>::value ||
+                                                      std::is_enum<KeyType>::value>::type> {
+    constexpr size_t operator()(KeyType key) const {
+        uint64_t mixed = static_cast<uint64_t>(key) + UINT64_C(0x9E3779B97F4A7C15);
+        mixed = (mixed ^ (mixed >> 30)) * UINT64_C(0xBF58476D1CE4E5B9);
+        mixed = (mixed ^ (mixed >> 27)) * UINT64_C(0x94D049BB133111EB);
+        return static_cast<size_t>(mixed ^ (mixed >> 31));
+    }
+};
+
+template<>
+struct ConstexprHash<std::string_view> {
+    constexpr size_t operator()(std::string_view key) const {
+        uint64_t hash = UINT64_C(14695981039346656037);
+        for (char c : key) {
+            hash = (hash ^ static_cast<unsigned char>(c)) * UINT64_C(1099511628211);
+        }
+        return static_cast<size_t>(hash);
+    }
+};
+
+/* Fixed hash table, that is built at compile time and never changes. Elements are kept in
+std::array in the order they were given, and the open addressing table of CAPACITY_ cells
+(power of two, at least twice the number of elements, so probes are short) keeps position + 1
+of an element or zero. There are no allocations and no startup work, a lookup is one hash and
+a few comparisons. Use make_static_hash_map to build it:
+    constexpr auto OPCODES = make_static_hash_map<std::string_view, int>({{"GET", 1}, {"PUT", 2}});
+    static_assert(OPCODES.at("PUT") == 2);
+Duplicate keys stop compilation (and throw invalid_argument if built at runtime). */
+template<class KeyType, class ValueType, size_t N, class Hash = ConstexprHash<KeyType>,
+                            class KeyEqual = std::equal_to<KeyType>>
+class StaticHashMap {
+ public:
+    using value_type = std::pair<KeyType, ValueType>;
+    using const_iterator = const value_type*;
+
+    // Builds the table from the elements. Time: expected O(N).
+    constexpr StaticHashMap(const value_type (&elements)[N], const Hash& hasher = Hash(),
+                            const KeyEqual& key_equal = KeyEqual()) :
+                        StaticHashMap(elements, std::make_index_sequence<N>(), hasher, key_equal) {}
+
+    // Time: O(1).
+    constexpr size_t size() const {
+        return N;
+    }
+
+    // Time: O(1).
+    constexpr bool empty() const {
+        return N == 0;
+    }
+
+    // Elements in the order they were given. Time: O(1).
+    constexpr const_iterator begin() const {
+        return elements_.data();
+    }
+
+    constexpr const_iterator end() const {
+        return elements_.data() + N;
+    }
+
+    // Returns pointer to the element with the key or end(). Time: expected O(1).
+    constexpr const_iterator find(const KeyType& key) const {
+        size_t position = find_position(key);
+        return position == N ? end() : begin() + position;
+    }
+
+    // Time: expected O(1).
+    constexpr bool contains(const KeyType& key) const {
+        return find_position(key) != N;
+    }
+
+    // Returns number of elements with the key, that is 0 or 1. Time: expected O(1).
+    constexpr size_t count(const KeyType& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    /* Returns reference to the value if this key is in the table.
+    Throws out_of_range exception otherwise. Time: expected O(1) */
+    constexpr const ValueType& at(const KeyType& key) const {
+        size_t position = find_position(key);
+        if (position == N) {
+            throw std::out_of_range("This element doesn't exist");
+        }
+        return elements_[position].second;
+    }
+
+ private:
+    constexpr static size_t capacity(size_t count) {
+        size_t result = 1;
+        while (result < 2 * count) {
+            result *= 2;
+        }
+        return result;
+    }
+
+    constexpr static size_t CAPACITY_ = capacity(N);
+
+    std::array<value_type, N> elements_;
+    std::array<size_t, CAPACITY_> cells_;
+    Hash hasher_;
+    KeyEqual key_equal_;
+
+    // Elements are copied at once, because std::pair can't be assigned in constexpr before C++20.
+    template<size_t... I>
+    constexpr StaticHashMap(const value_type (&elements)[N], std::index_sequence<I...>,
+                            const Hash& hasher, const KeyEqual& key_equal) :
+                        elements_{{elements[I]...}},
+                        cells_{},
+                        hasher_(hasher),
+                        key_equal_(key_equal) {
+        for (size_t position = 0; position < N; position++) {
+            size_t cell = hasher_(elements_[position].first) & (CAPACITY_ - 1);
+            while (cells_[cell] != 0) {
+                if (key_equal_(elements_[cells_[cell] - 1].first, elements_[position].first)) {
+                    throw std::invalid_argument("Duplicate key in StaticHashMap");
+                }
+                cell = (cell + 1) & (CAPACITY_ - 1);
+            }
+            cells_[cell] = position + 1;
+        }
+    }
+
+    // Position of the key in elements_ or N. Time: expected O(1).
+    constexpr size_t find_position(const KeyType& key) const {
+        for (size_t cell = hasher_(key) & (CAPACITY_ - 1); cells_[cell] != 0;
+                                                cell = (cell + 1) & (CAPACITY_ - 1)) {
+            if (key_equal_(elements_[cells_[cell] - 1].first, key)) {
+                return cells_[cell] - 1;
+            }
+        }
+        return N;
+    }
+};
+
+/* Builds StaticHashMap from braced list of pairs, the number of elements is deduced:
+make_static_hash_map<int, char>({{1, 'a'}, {2, 'b'}}). Time: expected O(N). */
+template<class KeyType, class ValueType, class Hash = ConstexprHash<KeyType>,
+                            class KeyEqual = std::equal_to<KeyType>, size_t N>
+constexpr StaticHashMap<KeyType, ValueType, N, Hash, KeyEqual> make_static_hash_map(
+                            const std::pair<KeyType, ValueType> (&elements)[N],
+                            const Hash& hasher = Hash(), const KeyEqual& key_equal = KeyEqual()) {
+    return StaticHashMap<KeyType, ValueType, N, Hash, KeyEqual>(elements, hasher, key_equal);
+}
+
+#endif  // STATIC_HASH_MAP_H_
@@ -0,0 +1,251 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <memory_resource>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "concurrent_hash_map.h"
+#include "hash_functions.h"
+#include "tests/test_util.h"
+
+namespace {
+
+void test_threads() {
+    ConcurrentHashMap<int, long> map(16);
+    CHECK(map.shard_count() == 16);
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < 8; thread++) {
+        threads.emplace_back([&map, thread] {
+            for (int i = 0; i < 20000; i++) {
+                map.upsert(i % 1000, [](long& value) { value++; });
+                long value;
+                map.find(i % 1000, value);
+                if (i % 7 == 0) {
+                    map.insert({100000 * (thread + 1) + i, 1});
+                }
+                if (i % 11 == 0) {
+                    map.erase(100000 * (thread + 1) + i - 77);
+                }
+                map.update(i % 1000, [](long& value) { value += 0; });
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    long total = 0;
+    for (int key = 0; key < 1000; key++) {
+        long value = 0;
+        CHECK(map.find(key, value));
+        total += value;
+    }
+    CHECK(total == 8 * 20000);
+    size_t count = 0;
+    map.for_each([&count](const auto&) { count++; });
+    CHECK(count == map.size());
+    map.clear();
+    CHECK(map.empty());
+}
+
+void test_policies() {
+    ConcurrentHashMap<int, int, std::hash<int>, std::equal_to<int>,
+                      std::allocator<std::pair<const int, int>>, ChainedIndex<>, false,
+                      SplitStorage> map;
+    map.insert({1, 1});
+    map.upsert(1, [](int& value) { value++; });
+    int value = 0;
+    CHECK(map.find(1, value) && value == 2);
+    CHECK(map.visit(1, [](const int& found) { CHECK(found == 2); }));
+    CHECK(!map.visit(2, [](const int&) {}));
+    CHECK(!map.insert_or_assign(1, 5) && map.find(1, value) && value == 5);
+    map.for_each([](const auto& element) { CHECK(element.first == 1); });
+    map.reserve(1000);
+    CHECK(map.size() == 1 && map.erase(1) == 1 && map.empty());
+}
+
+/* Every operation hashes the key once, for the shard and for the map in it. The shards are
+reserved, rehashes of uncached hashes would hash the keys again. */
+template<class StoragePolicy>
+void test_hashes_once() {
+    ConcurrentHashMap<int, int, CountingHash<int>, std::equal_to<int>,
+                      std::allocator<std::pair<const int, int>>, ChainedIndex<>, false,
+                      StoragePolicy> map(4);
+    map.reserve(400);
+    size_t calls = CountingHash<int>::calls;
+    for (int i = 0; i < 100; i++) {
+        map.insert({i, i});
+        std::pair<int, int> element(i, 0);
+        map.insert(std::move(element));
+        map.insert_or_assign(i, 2 * i);
+        map.upsert(i, [](int& value) { value++; });
+        map.update(i, [](int& value) { value++; });
+    }
+    CHECK(CountingHash<int>::calls - calls == 500);
+    calls = CountingHash<int>::calls;
+    int value = 0;
+    for (int i = 0; i < 200; i++) {
+        CHECK(map.contains(i) == (i < 100));
+        CHECK(map.find(i, value) == (i < 100) && (i >= 100 || value == 2 * i + 2));
+        map.visit(i, [i](const int& found) { CHECK(found == 2 * i + 2); });
+    }
+    // Erase of a present key may shrink the shard and hash the rest, absent keys are counted.
+    for (int i = 100; i < 200; i++) {
+        CHECK(map.erase(i) == 0);
+    }
+    CHECK(CountingHash<int>::calls - calls == 700);
+    for (int i = 0; i < 100; i++) {
+        CHECK(map.erase(i) == 1);
+    }
+    CHECK(map.empty());
+}
+
+void test_stats() {
+    ConcurrentHashMap<int, int, std::hash<int>, std::equal_to<int>,
+                      std::allocator<std::pair<const int, int>>, ChainedIndex<>, false,
+                      PairStorage, CountingStats> map(8);
+    for (int i = 0; i < 1000; i++) {
+        map.insert({i, i});
+    }
+    std::vector<std::thread> threads;
+    for (int thread = 0; thread < 4; thread++) {
+        threads.emplace_back([&map] {
+            for (int i = 0; i < 2000; i++) {
+                map.contains(i);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    auto stats = map.stats();
+    CHECK(stats.size == 1000 && stats.lookups == 9000 && stats.hits == 4000);
+}
+
+// Allocator of a shard remembers its number, it doesn't propagate and has no default.
+template<class T>
+struct ShardAllocator {
+    using value_type = T;
+
+    explicit ShardAllocator(size_t number) : shard(number) {}
+
+    template<class U>
+    ShardAllocator(const ShardAllocator<U>& other) : shard(other.shard) {}  // NOLINT
+
+    T* allocate(size_t count) {
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T* pointer, size_t count) {
+        std::allocator<T>().deallocate(pointer, count);
+    }
+
+    size_t shard;
+};
+
+template<class T, class U>
+bool operator==(const ShardAllocator<T>& left, const ShardAllocator<U>& right) {
+    return left.shard == right.shard;
+}
+
+template<class T, class U>
+bool operator!=(const ShardAllocator<T>& left, const ShardAllocator<U>& right) {
+    return left.shard != right.shard;
+}
+
+void test_shard_allocators() {
+    using Allocator = ShardAllocator<std::pair<const uint64_t, uint64_t>>;
+    ConcurrentHashMap<uint64_t, uint64_t, WyHash<uint64_t>, std::equal_to<uint64_t>, Allocator,
+                      GroupProbingIndex<>> map(8, [](size_t shard) { return Allocator(shard); });
+    std::vector<std::thread> threads;
+    for (uint64_t thread = 0; thread < 4; thread++) {
+        threads.emplace_back([&map, thread] {
+            for (uint64_t i = thread; i < 100000; i += 4) {
+                map.insert({i, i});
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    CHECK(map.size() == 100000);
+    for (size_t i = 0; i < map.shard_count(); i++) {
+        CHECK(map.shard_allocator(i).shard == i);
+    }
+    CHECK(map.shard_number(17) < map.shard_count());
+    map.clear();
+    CHECK(map.shard_allocator(3).shard == 3);
+    ConcurrentHashMap<uint64_t, uint64_t> plain(8, std::hash<uint64_t>());
+    CHECK(plain.shard_count() == 8);
+}
+
+// Every shard allocates from the resource of its constructor.
+void test_pmr() {
+    using Allocator = std::pmr::polymorphic_allocator<std::pair<const int, std::pmr::string>>;
+    using Map = ConcurrentHashMap<int, std::pmr::string, std::hash<int>, std::equal_to<int>,
+                                  Allocator>;
+    std::pmr::monotonic_buffer_resource resource;
+    Map map(4, std::hash<int>(), std::equal_to<int>(), Allocator(&resource));
+    for (size_t i = 0; i < map.shard_count(); i++) {
+        CHECK(map.shard_allocator(i).resource() == &resource);
+    }
+    std::pmr::monotonic_buffer_resource resources[4];
+    Map placed(4, [&resources](size_t shard) { return Allocator(&resources[shard]); });
+    for (int i = 0; i < 1000; i++) {
+        map.insert({i, std::pmr::string(40, 'v')});
+        placed.insert({i, std::pmr::string(40, 'v')});
+    }
+    for (size_t i = 0; i < placed.shard_count(); i++) {
+        CHECK(placed.shard_allocator(i).resource() == &resources[i]);
+        placed.visit_shard(i, [&resources, i](const Map::Shard& shard) {
+            for (const auto& element : shard) {
+                CHECK(element.second.get_allocator().resource() == &resources[i]);
+            }
+        });
+    }
+}
+
+/* Longest chain (bucket, cluster or run of groups) over all shards of 64: the shard must not
+be picked from the bits that the index of the shard uses for buckets. */
+template<class IndexPolicy>
+size_t longest_shard_chain() {
+    ConcurrentHashMap<uint64_t, int, std::hash<uint64_t>, std::equal_to<uint64_t>,
+                      std::allocator<std::pair<const uint64_t, int>>, IndexPolicy> map(64);
+    for (uint64_t i = 0; i < 200000; i++) {
+        map.insert({i * 7919 + 13, 1});
+    }
+    size_t longest = 0;
+    for (size_t i = 0; i < map.shard_count(); i++) {
+        map.visit_shard(i, [&longest](const auto& shard) {
+            longest = std::max(longest, shard.max_chain_length());
+        });
+    }
+    return longest;
+}
+
+void test_shard_independence() {
+    CHECK(longest_shard_chain<ChainedIndex<FibonacciSizing>>() <= 10);
+    CHECK(longest_shard_chain<ChainedIndex<PowerOfTwoSizing>>() <= 10);
+    CHECK(longest_shard_chain<ChainedIndex<>>() <= 10);
+    CHECK(longest_shard_chain<OpenAddressingIndex<FibonacciSizing>>() <= 200);
+    CHECK(longest_shard_chain<OpenAddressingIndex<PowerOfTwoSizing>>() <= 200);
+    CHECK(longest_shard_chain<GroupProbingIndex<FibonacciSizing>>() <= 8);
+}
+
+}  // namespace
+
+int main() {
+    test_threads();
+    test_policies();
+    test_hashes_once<PairStorage>();
+    test_hashes_once<InlineStorage<8>>();
+    test_stats();
+    test_shard_allocators();
+    test_pmr();
+    test_shard_independence();
+    return 0;
+}
@@ -0,0 +1,202 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+/* Differential fuzz: random operations are applied to HashMap and std::unordered_map, and the
+results and contents are compared, over every index, sizing and storage policy, with and
+without cached hashes, with int and string keys and a hash with many collisions. */
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+
+#include "hash_map_2.h"
+#include "tests/test_util.h"
+
+namespace {
+
+// Hash with only seven values, every chain and probe sequence is long.
+struct CollidingHash {
+    size_t operator()(int key) const {
+        return static_cast<size_t>(key) % 7;
+    }
+};
+
+template<class Map, class Reference>
+void check_equal(const Map& map, const Reference& reference) {
+    CHECK(map.size() == reference.size());
+    size_t count = 0;
+    for (auto&& element : map) {
+        auto position = reference.find(element.first);
+        CHECK(position != reference.end() && position->second == element.second);
+        count++;
+    }
+    CHECK(count == reference.size());
+    for (const auto& element : reference) {
+        CHECK(map.at(element.first) == element.second);
+    }
+}
+
+template<class KeyType, class Hash, class IndexPolicy, bool CacheHash, class StoragePolicy>
+void fuzz(unsigned seed, int operations) {
+    using Map = HashMap<KeyType, std::string, Hash, std::equal_to<KeyType>,
+                        std::allocator<std::pair<const KeyType, std::string>>, IndexPolicy,
+                        CacheHash, StoragePolicy>;
+    std::mt19937 random(seed);
+    Map map;
+    std::unordered_map<KeyType, std::string> reference;
+    if (seed % 2 == 1) {
+        map.min_load_factor(0.1f);
+    }
+    // Small key ranges keep InlineStorage in its linear mode and switch it back and forth.
+    int range = (seed % 3 == 0) ? 12 : 2000;
+    for (int i = 0; i < operations; i++) {
+        KeyType key = make_key<KeyType>(static_cast<int>(random() % range));
+        std::string value = std::to_string(random()) + std::string(random() % 30, 'v');
+        switch (random() % 16) {
+        case 0:
+        case 1:
+        case 2: {
+            auto result = map.insert({key, value});
+            auto expected = reference.insert({key, value});
+            CHECK(result.second == expected.second);
+            CHECK(result.first->second == expected.first->second);
+            break;
+        }
+        case 3: {
+            auto result = map.try_emplace(key, value);
+            auto expected = reference.try_emplace(key, value);
+            CHECK(result.second == expected.second);
+            CHECK(result.first->second == expected.first->second);
+            break;
+        }
+        case 4: {
+            auto result = map.insert_or_assign(key, value);
+            auto expected = reference.insert_or_assign(key, value);
+            CHECK(result.second == expected.second && result.first->second == value);
+            break;
+        }
+        case 5: {
+            auto result = map.emplace(key, value);
+            auto expected = reference.emplace(key, value);
+            CHECK(result.second == expected.second);
+            CHECK(result.first->second == expected.first->second);
+            break;
+        }
+        case 6:
+            map[key] += "+";
+            reference[key] += "+";
+            break;
+        case 7:
+        case 8:
+            CHECK(map.erase(key) == reference.erase(key));
+            break;
+        case 9: {
+            auto position = map.find(key);
+            if (position != map.end()) {
+                map.erase(typename Map::const_iterator(position));
+                reference.erase(key);
+            }
+            break;
+        }
+        case 10:
+            if (random() % 100 == 0) {
+                size_t length = random() % 30;
+                auto predicate = [length](auto&& element) {
+                    return element.second.size() < length;
+                };
+                size_t expected = 0;
+                for (auto position = reference.begin(); position != reference.end();) {
+                    if (predicate(*position)) {
+                        position = reference.erase(position);
+                        expected++;
+                    } else {
+                        ++position;
+                    }
+                }
+                CHECK(map.erase_if(predicate) == expected);
+            }
+            break;
+        case 11: {
+            KeyType keys[3] = {key, make_key<KeyType>(1), make_key<KeyType>(2)};
+            bool found[3];
+            map.contains_batch(keys, 3, found);
+            for (size_t j = 0; j < 3; j++) {
+                CHECK(found[j] == (reference.count(keys[j]) == 1));
+            }
+            break;
+        }
+        case 12:
+            if (random() % 50 == 0) {
+                Map copy(map);
+                map = copy;
+            } else if (random() % 50 == 0) {
+                Map moved(std::move(map));
+                map = std::move(moved);
+            }
+            break;
+        case 13:
+            if (random() % 300 == 0) {
+                map.clear();
+                reference.clear();
+            } else if (random() % 300 == 0) {
+                map.clear_keep_capacity();
+                reference.clear();
+            } else if (random() % 100 == 0) {
+                map.reserve(random() % 3000);
+            } else if (random() % 100 == 0) {
+                map.rehash(random() % 3000);
+            } else if (random() % 100 == 0) {
+                map.shrink_to_fit();
+            }
+            break;
+        default: {
+            auto position = map.find(key);
+            auto expected = reference.find(key);
+            CHECK((position == map.end()) == (expected == reference.end()));
+            CHECK(map.contains(key) == (expected != reference.end()));
+            if (expected != reference.end()) {
+                CHECK(position->second == expected->second);
+            }
+            break;
+        }
+        }
+        CHECK(map.size() == reference.size());
+    }
+    check_equal(map, reference);
+    const Map& constant = map;
+    auto frozen = constant.freeze();
+    CHECK(frozen.size() == reference.size());
+    for (const auto& element : reference) {
+        CHECK(frozen.at(element.first) == element.second);
+    }
+}
+
+template<class IndexPolicy, bool CacheHash, class StoragePolicy>
+void fuzz_storage(unsigned seed) {
+    fuzz<int, std::hash<int>, IndexPolicy, CacheHash, StoragePolicy>(seed, 20000);
+    fuzz<std::string, std::hash<std::string>, IndexPolicy, CacheHash, StoragePolicy>(seed, 10000);
+    fuzz<int, CollidingHash, IndexPolicy, CacheHash, StoragePolicy>(seed, 3000);
+}
+
+template<class IndexPolicy, bool CacheHash>
+void fuzz_index(unsigned seed) {
+    fuzz_storage<IndexPolicy, CacheHash, PairStorage>(seed);
+    fuzz_storage<IndexPolicy, CacheHash, SplitStorage>(seed);
+    fuzz_storage<IndexPolicy, CacheHash, InlineStorage<4>>(seed);
+}
+
+}  // namespace
+
+int main() {
+    for (unsigned seed = 0; seed < 4; seed++) {
+        fuzz_index<ChainedIndex<>, false>(seed);
+        fuzz_index<ChainedIndex<PowerOfTwoSizing>, true>(seed);
+        fuzz_index<IncrementalChainedIndex<FibonacciSizing>, true>(seed);
+        fuzz_index<OpenAddressingIndex<PowerOfTwoSizing>, false>(seed);
+        fuzz_index<OpenAddressingIndex<PrimeSizing>, true>(seed);
+        fuzz_index<GroupProbingIndex<>, false>(seed);
+        fuzz_index<GroupProbingIndex<PowerOfTwoSizing>, true>(seed);
+    }
+    return 0;
+}
@@ -0,0 +1,78 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+#include "hash_cache.h"
+#include "hash_functions.h"
+#include "tests/test_util.h"
+
+namespace {
+
+using Allocator = CountingAllocator<std::pair<const uint64_t, int>>;
+
+// After the constructor the cache allocates nothing over 200k mixed operations.
+template<class Hash, class IndexPolicy, bool CacheHash, class StoragePolicy>
+void test_no_allocations() {
+    AllocationCounter counter;
+    HashCache<uint64_t, int, Hash, std::equal_to<uint64_t>, Allocator, IndexPolicy, CacheHash,
+              StoragePolicy> cache(100, Hash(), std::equal_to<uint64_t>(), Allocator(&counter));
+    std::mt19937 random(5);
+    for (int i = 0; i < 1000; i++) {
+        cache.put(random() % 300, i);
+    }
+    size_t allocations = counter.allocations;
+    size_t hits = 0;
+    for (int i = 0; i < 200000; i++) {
+        uint64_t key = (random() % 4 == 0) ? random() % 10 : random() % 1000;
+        if (int* value = cache.get(key)) {
+            hits++;
+            CHECK(*value >= 0);
+        } else {
+            cache.put(key, i);
+        }
+        CHECK(cache.size() <= cache.capacity());
+        if (i % 5000 == 0) {
+            cache.erase(random() % 1000);
+        }
+    }
+    CHECK(hits > 0);
+    size_t count = 0;
+    cache.for_each([&count](uint64_t, int) { count++; });
+    CHECK(count == cache.size());
+    cache.clear();
+    CHECK(cache.empty());
+    cache.put(1, 2);
+    CHECK(*cache.peek(1) == 2);
+    CHECK(counter.allocations == allocations);
+}
+
+void test_eviction() {
+    HashCache<std::string, std::string> cache(2);
+    CHECK(cache.put("a", "1") && cache.put("b", "2"));
+    cache.get("a");
+    // b is the element without the referenced bit.
+    CHECK(cache.put("c", "3"));
+    CHECK(cache.contains("a") && !cache.contains("b") && cache.contains("c"));
+    CHECK(!cache.put("a", "x") && *cache.get("a") == "x");
+    CHECK(cache.put("d", "4") && cache.size() == 2);
+    CHECK_THROWS(std::invalid_argument, HashCache<int, int>(0));
+    HashCache<int, int> one(1);
+    one.put(1, 1);
+    one.put(2, 2);
+    CHECK(one.size() == 1 && one.contains(2));
+}
+
+}  // namespace
+
+int main() {
+    test_no_allocations<std::hash<uint64_t>, OpenAddressingIndex<>, false, PairStorage>();
+    test_no_allocations<WyHash<uint64_t>, OpenAddressingIndex<PowerOfTwoSizing>, true,
+                        SplitStorage>();
+    test_eviction();
+    return 0;
+}
@@ -0,0 +1,81 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hash_counter.h"
+#include "tests/test_util.h"
+
+namespace {
+
+void test_against_map() {
+    HashCounter<int> counter;
+    std::unordered_map<int, int64_t> reference;
+    std::mt19937 random(2);
+    std::vector<int> keys;
+    // Two thirds of the keys are ten hot ones.
+    for (int i = 0; i < 100000; i++) {
+        keys.push_back((random() % 3000 < 2000) ? random() % 10 : random() % 50000);
+    }
+    counter.add_all(keys);
+    for (int key : keys) {
+        reference[key]++;
+    }
+    std::vector<int64_t> deltas(keys.size(), -2);
+    counter.add_all(keys.data(), deltas.data(), keys.size());
+    for (int key : keys) {
+        reference[key] -= 2;
+    }
+    for (int i = 0; i < 1000; i++) {
+        CHECK(counter.add(i, 3) == (reference[i] += 3));
+    }
+    for (const auto& element : reference) {
+        CHECK(counter.count(element.first) == element.second);
+    }
+    CHECK(counter.size() == reference.size() && counter.count(-1) == 0);
+    auto top = counter.most_common(3);
+    CHECK(top.size() == 3 && top[0].second >= top[1].second && top[1].second >= top[2].second);
+    CHECK(counter.erase(0) == 1 && !counter.contains(0));
+}
+
+// All keys collide, equal hashes of different keys are summed separately.
+struct SameHash {
+    size_t operator()(const std::string&) const {
+        return 7;
+    }
+};
+
+void test_collisions() {
+    HashCounter<std::string, int, SameHash> counter;
+    std::vector<std::string> words = {"x", "y", "x", "z", "y", "x"};
+    counter.add_all(words);
+    CHECK(counter.count("x") == 3 && counter.count("y") == 2 && counter.count("z") == 1);
+    CHECK(counter.size() == 3);
+    counter.add_all(std::array<std::string, 2>{"x", "w"});
+    CHECK(counter.count("x") == 4 && counter.count("w") == 1);
+
+    HashCounter<int, int, std::hash<int>, std::equal_to<int>,
+                std::allocator<std::pair<const int, int>>, ChainedIndex<>, false,
+                InlineStorage<8>> small;
+    small.add_all({1, 2, 1});
+    CHECK(small.count(1) == 2);
+    for (int i = 0; i < 100; i++) {
+        small.add(i);
+    }
+    CHECK(small.count(1) == 3 && small.size() == 100);
+}
+
+}  // namespace
+
+int main() {
+    test_against_map();
+    test_collisions();
+    return 0;
+}
@@ -0,0 +1,105 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "hash_functions.h"
+#include "hash_map_2.h"
+#include "tests/test_util.h"
+
+namespace {
+
+template<class KeyType, class Hash, class IndexPolicy>
+bool skewed(size_t count, size_t stride, float max_load_factor) {
+    HashMap<KeyType, int, Hash, std::equal_to<KeyType>,
+            std::allocator<std::pair<const KeyType, int>>, IndexPolicy> map;
+    if (max_load_factor > 0) {
+        map.max_load_factor(max_load_factor);
+    }
+    for (size_t i = 0; i < count; i++) {
+        map[static_cast<KeyType>(i * stride)] = 1;
+    }
+    return map.skewed();
+}
+
+void test_skew() {
+    // Identity hash with a power of two stride and power of two buckets is skewed.
+    using PowerOfTwo = ChainedIndex<PowerOfTwoSizing>;
+    CHECK(skewed<uint64_t, std::hash<uint64_t>, PowerOfTwo>(100000, 1024, 0));
+    CHECK(!skewed<uint64_t, WyHash<uint64_t>, PowerOfTwo>(100000, 1024, 0));
+    CHECK(!skewed<uint64_t, MixedHash<std::hash<uint64_t>>, PowerOfTwo>(100000, 1024, 0));
+    CHECK(skewed<uint64_t, std::hash<uint64_t>, OpenAddressingIndex<PowerOfTwoSizing>>(
+                    100000, 4096, 0));
+    CHECK(!skewed<uint64_t, WyHash<uint64_t>, OpenAddressingIndex<PowerOfTwoSizing>>(
+                    100000, 4096, 0));
+    CHECK(skewed<uint64_t, std::hash<uint64_t>, GroupProbingIndex<PowerOfTwoSizing>>(
+                    100000, 1 << 16, 0));
+    // Good hashes are never reported, at any load.
+    for (size_t count : {10, 1000, 100000}) {
+        for (float load : {0.5f, 0.667f, 0.875f, 4.0f}) {
+            CHECK(!skewed<uint64_t, WyHash<uint64_t>, ChainedIndex<>>(count, 1, load));
+            CHECK(!skewed<uint64_t, WyHash<uint64_t>, IncrementalChainedIndex<FibonacciSizing>>(
+                            count, 7, load));
+            CHECK(!skewed<uint64_t, WyHash<uint64_t>, OpenAddressingIndex<PowerOfTwoSizing>>(
+                            count, 3, load));
+            CHECK(!skewed<uint64_t, WyHash<uint64_t>, GroupProbingIndex<>>(count, 5, load));
+        }
+    }
+}
+
+// A good hash, that only takes 128 values, so chains use 1/64 of 8192 buckets for 3126 keys.
+struct NarrowHash {
+    size_t operator()(uint64_t key) const {
+        return static_cast<size_t>(wyhash_64(key, 0) % 128);
+    }
+};
+
+// A good hash, that only reaches every 64th power of two bucket.
+struct SparseHash {
+    size_t operator()(uint64_t key) const {
+        return static_cast<size_t>(wyhash_64(key, 0) << 6);
+    }
+};
+
+void test_narrow_buckets() {
+    // Chains of about 24 keys, far above the Poisson tail at the load of the whole table.
+    CHECK(skewed<uint64_t, NarrowHash, ChainedIndex<>>(3126, 1, 0));
+    CHECK(skewed<uint64_t, NarrowHash, ChainedIndex<FibonacciSizing>>(3126, 1, 0));
+    CHECK(skewed<uint64_t, NarrowHash, IncrementalChainedIndex<FibonacciSizing>>(3126, 1, 0));
+    CHECK(skewed<uint64_t, SparseHash, ChainedIndex<PowerOfTwoSizing>>(3126, 1, 0));
+    CHECK(skewed<uint64_t, SparseHash, ChainedIndex<PowerOfTwoSizing>>(100000, 1, 0));
+    CHECK(skewed<uint64_t, SparseHash, ChainedIndex<PowerOfTwoSizing>>(3126, 1, 4.0f));
+}
+
+void test_wyhash() {
+    CHECK(WyHash<std::string>()("abc") == WyHash<std::string_view>()("abc"));
+    CHECK(WyHash<std::string>(1)("abc") != WyHash<std::string>(2)("abc"));
+    CHECK(wyhash_bytes("abc", 3, 0) == wyhash_bytes(std::string("abc").data(), 3, 0));
+    CHECK(wyhash_64(1, 0) != wyhash_64(2, 0));
+    CHECK(WyHash<int>(1) == WyHash<int>(1) && !(WyHash<int>(1) == WyHash<int>(2)));
+    CHECK(MixedHash<std::hash<int>>() == MixedHash<std::hash<int>>());
+    static_assert(IsTransparent<MixedHash<WyHash<std::string>>>::value, "");
+    static_assert(!IsTransparent<MixedHash<std::hash<int>>>::value, "");
+
+    HashMap<std::string, int, WyHash<std::string>, std::equal_to<>> map;
+    map["hello"] = 1;
+    map[std::string(100, 'x')] = 2;
+    CHECK(map.find(std::string_view("hello"))->second == 1);
+    CHECK(map.contains(std::string_view(std::string(100, 'x'))));
+    HashMap<std::string, int, MixedHash<WyHash<std::string>>, std::equal_to<>> mixed;
+    mixed["hello"] = 1;
+    CHECK(mixed.contains(std::string_view("hello")));
+}
+
+}  // namespace
+
+int main() {
+    test_skew();
+    test_narrow_buckets();
+    test_wyhash();
+    return 0;
+}
@@ -0,0 +1,50 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#include <functional>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "concurrent_hash_map.h"
+#include "hash_functions.h"
+#include "hash_map_2.h"
+#include "hash_map_2version.h"
+#include "read_mostly_hash_map.h"
+#include "tests/test_util.h"
+
+namespace {
+
+using Sharded = HashMapPolicies<GroupProbingIndex<>, true>::with_sizing<PowerOfTwoSizing>::
+                                with_threading<ShardedLocking>;
+static_assert(std::is_same<ConfiguredHashMap<int, int, Sharded, WyHash<int>>,
+                           ConcurrentHashMap<int, int, WyHash<int>, std::equal_to<int>,
+                                             std::allocator<std::pair<const int, int>>,
+                                             GroupProbingIndex<PowerOfTwoSizing>, true,
+                                             PairStorage, NoStats>>::value, "");
+static_assert(std::is_same<ConfiguredHashMap<int, int>, HashMap<int, int>>::value, "");
+static_assert(std::is_same<ConfiguredHashMap<int, int, HashMapPolicies<>::
+                                             with_threading<ReadCopyUpdate>::
+                                             with_stats<CountingStats>::
+                                             with_storage<SplitStorage>>,
+                           ReadMostlyHashMap<int, int, std::hash<int>, std::equal_to<int>,
+                                             std::allocator<std::pair<const int, int>>,
+                                             ChainedIndex<>, false, SplitStorage,
+                                             CountingStats>>::value, "");
+static_assert(std::is_same<HashMapPolicies<>::with_sizing<FibonacciSizing>::
+                                           with_index<IncrementalChainedIndex<>>::
+                                           with_sizing<PrimeSizing>::index,
+                           IncrementalChainedIndex<PrimeSizing>>::value, "");
+static_assert(HashMapPolicies<>::with_cache_hash<true>::CACHE_HASH, "");
+
+}  // namespace
+
+int main() {
+    HashMap<int, int> map;
+    map.insert({1, 2});
+    map.erase(1);
+    map[3] = 4;
+    CHECK(map.at(3) == 4 && !map.contains(1));
+    ConfiguredHashMap<int, int, Sharded, WyHash<int>> sharded(4);
+    sharded.insert({1, 1});
+    CHECK(sharded.contains(1));
+    return 0;
+}
@@ -0,0 +1,786 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hash_functions.h"
+#include "hash_map_2.h"
+#include "tests/test_util.h"
+
+namespace {
+
+template<class KeyType, class ValueType, class IndexPolicy = ChainedIndex<>,
+         bool CacheHash = false, class StoragePolicy = PairStorage,
+         class Hash = std::hash<KeyType>>
+using Map = HashMap<KeyType, ValueType, Hash, std::equal_to<KeyType>,
+                    std::allocator<std::pair<const KeyType, ValueType>>, IndexPolicy, CacheHash,
+                    StoragePolicy>;
+
+// Value that counts its copies, moves are free.
+struct Counted {
+    static inline int copies = 0;
+
+    Counted() = default;
+    Counted(int number) : value(number) {}  // NOLINT
+    Counted(const Counted& other) : value(other.value) {
+        copies++;
+    }
+    Counted(Counted&& other) noexcept : value(other.value) {}
+    Counted& operator=(const Counted& other) {
+        value = other.value;
+        copies++;
+        return *this;
+    }
+    Counted& operator=(Counted&& other) noexcept {
+        value = other.value;
+        return *this;
+    }
+
+    int value = 0;
+};
+
+// Value with a throwing move, its copy throws when copies_left reaches zero.
+struct ThrowingCopy {
+    static inline int copies_left = -1;
+
+    ThrowingCopy(std::string other_text) : text(std::move(other_text)) {}  // NOLINT
+    ThrowingCopy(const ThrowingCopy& other) : text(other.text) {
+        if (copies_left-- == 0) {
+            throw std::runtime_error("copy");
+        }
+    }
+    ThrowingCopy(ThrowingCopy&& other) : text(std::move(other.text)) {}
+    ThrowingCopy& operator=(const ThrowingCopy& other) = default;
+    ThrowingCopy& operator=(ThrowingCopy&& other) = default;
+
+    std::string text;
+};
+
+template<class M>
+void test_constructors() {
+    std::vector<std::pair<int, int>> pairs;
+    for (int i = 0; i < 30000; i++) {
+        pairs.push_back({i % 20000, i});
+    }
+    M from_range(pairs.begin(), pairs.end());
+    CHECK(from_range.size() == 20000 && from_range.at(5) == 5);
+    M listed{{1, 2}, {3, 4}, {1, 5}};
+    CHECK(listed.size() == 2 && listed.at(1) == 2);
+    listed.reserve(1000);
+    size_t bucket_count = listed.bucket_count();
+    for (int i = 0; i < 1000; i++) {
+        listed.insert({i, i});
+    }
+    CHECK(listed.bucket_count() == bucket_count);
+    listed.rehash(1);
+    CHECK(listed.size() == 1000);
+    listed.rehash(50000);
+    CHECK(listed.bucket_count() >= 50000);
+    for (int i = 0; i < 1000; i++) {
+        CHECK(listed.contains(i));
+    }
+    std::list<std::pair<int, int>> list(pairs.begin(), pairs.begin() + 10);
+    M from_list(list.begin(), list.end());
+    CHECK(from_list.size() == 10);
+}
+
+void test_insert_hashes_once() {
+    using M = Map<std::string, int, ChainedIndex<>, false, PairStorage,
+                  CountingHash<std::string>>;
+    M map;
+    map.reserve(100);
+    CountingHash<std::string>::calls = 0;
+    map["a"]++;
+    map["a"]++;
+    CHECK(CountingHash<std::string>::calls == 2 && map["a"] == 2);
+    auto result = map.insert({"b", 1});
+    CHECK(result.second && result.first->second == 1);
+    result = map.insert({"b", 5});
+    CHECK(!result.second && result.first->second == 1);
+    result = map.insert_or_assign("b", 7);
+    CHECK(!result.second && map.at("b") == 7);
+    result = map.emplace("d", 4);
+    CHECK(result.second && map.at("d") == 4);
+
+    Map<int, std::unique_ptr<int>> unique;
+    auto pointer = std::make_unique<int>(3);
+    CHECK(unique.try_emplace(1, std::move(pointer)).second && *unique[1] == 3 && !pointer);
+    auto kept = std::make_unique<int>(4);
+    CHECK(!unique.try_emplace(1, std::move(kept)).second && kept);
+    CHECK(!unique.emplace(1, std::move(kept)).second && kept);
+    CHECK(unique.emplace(2, std::move(kept)).second && *unique[2] == 4 && !kept);
+    CHECK(unique.emplace(std::piecewise_construct, std::forward_as_tuple(3),
+                         std::forward_as_tuple(new int(5))).second && *unique[3] == 5);
+
+    // Erase with cached hashes hashes the key once, erase_if never does.
+    using Cached = Map<int, int, ChainedIndex<>, true, PairStorage, CountingHash<int>>;
+    Cached cached;
+    for (int i = 0; i < 1000; i++) {
+        cached[i] = i;
+    }
+    size_t before = CountingHash<int>::calls;
+    for (int i = 0; i < 500; i++) {
+        cached.erase(2 * i);
+    }
+    CHECK(CountingHash<int>::calls - before == 500);
+    before = CountingHash<int>::calls;
+    cached.erase_if([](auto&& element) { return element.first % 3 == 0; });
+    CHECK(CountingHash<int>::calls == before);
+}
+
+/* Arguments of try_emplace and emplace may refer to elements of the table, also when the insert
+moves the inline elements to the heap. */
+template<class M>
+void test_aliasing_arguments() {
+    M map;
+    map.try_emplace(0, std::string(40, 'v'));
+    for (int i = 1; i < 20; i++) {
+        map.try_emplace(i, map.find(i - 1)->second);
+        CHECK(map.at(i) == std::string(40, 'v'));
+    }
+    for (int i = 20; i < 40; i++) {
+        map.emplace(i, map.at(0));
+        CHECK(map.at(i) == std::string(40, 'v'));
+    }
+    for (int i = 0; i < 40; i++) {
+        CHECK(map.at(i) == std::string(40, 'v'));
+    }
+}
+
+// Hash of string_view, that finds std::string keys without building strings.
+struct ViewHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view key) const {
+        return std::hash<std::string_view>()(key);
+    }
+};
+
+void test_transparent_lookup() {
+    HashMap<std::string, int, ViewHash, std::equal_to<>> map{{"alpha", 1}, {"beta", 2}};
+    std::string_view alpha = "alpha";
+    CHECK(map.find(alpha) != map.end() && map.find(alpha)->second == 1);
+    CHECK(map.contains("beta") && map.count(std::string_view("gamma")) == 0);
+    CHECK(map.at("beta") == 2);
+    map.erase(std::string_view("alpha"));
+    CHECK(!map.contains(alpha) && map.size() == 1);
+    Map<std::string, int> plain{{"x", 1}};
+    CHECK(plain.contains("x") && plain.count("y") == 0);
+    CHECK_THROWS(std::out_of_range, plain.at("zz"));
+}
+
+template<class IndexPolicy>
+void test_pmr() {
+    std::pmr::monotonic_buffer_resource arena(1 << 20);
+    PmrHashMap<std::pmr::string, int, std::hash<std::pmr::string>,
+               std::equal_to<std::pmr::string>, IndexPolicy, true> map(&arena);
+    for (int i = 0; i < 3000; i++) {
+        map[std::pmr::string("key-number-long-enough-" + std::to_string(i), &arena)] = i;
+    }
+    for (int i = 0; i < 3000; i += 3) {
+        map.erase(std::pmr::string("key-number-long-enough-" + std::to_string(i), &arena));
+    }
+    CHECK(map.size() == 2000);
+    CHECK(map.begin()->first.get_allocator().resource() == &arena);
+}
+
+void test_allocators() {
+    test_pmr<ChainedIndex<>>();
+    test_pmr<IncrementalChainedIndex<>>();
+    test_pmr<OpenAddressingIndex<>>();
+    test_pmr<GroupProbingIndex<>>();
+
+    using Allocator = CountingAllocator<std::pair<const int, int>>;
+    AllocationCounter counter;
+    {
+        HashMap<int, int, std::hash<int>, std::equal_to<int>, Allocator,
+                IncrementalChainedIndex<PowerOfTwoSizing>, true> map{Allocator(&counter)};
+        for (int i = 0; i < 1000; i++) {
+            map[i] = i;
+        }
+        CHECK(counter.allocations > 0);
+        HashMap<int, int, std::hash<int>, std::equal_to<int>, Allocator, GroupProbingIndex<>>
+                        group{Allocator(&counter)};
+        for (int i = 0; i < 1000; i++) {
+            group[i] = i;
+        }
+        for (int i = 0; i < 1000; i++) {
+            group.erase(i);
+        }
+    }
+    CHECK(counter.allocations == counter.deallocations);
+
+    // Empty tables allocate nothing.
+    AllocationCounter empty;
+    {
+        HashMap<int, int, std::hash<int>, std::equal_to<int>, Allocator> chained{
+                        Allocator(&empty)};
+        HashMap<int, int, std::hash<int>, std::equal_to<int>, Allocator, GroupProbingIndex<>>
+                        group{Allocator(&empty)};
+        HashMap<int, int, std::hash<int>, std::equal_to<int>, Allocator, OpenAddressingIndex<>,
+                true, SplitStorage> open{Allocator(&empty)};
+        CHECK(chained.find(1) == chained.end() && !group.contains(1) && open.count(2) == 0);
+        chained.erase(1);
+        group.erase(1);
+        CHECK(chained.load_factor() == 0);
+    }
+    CHECK(empty.allocations == 0);
+
+    // Small inline tables allocate nothing and never hash.
+    using Tiny = HashMap<int, int, CountingHash<int>, std::equal_to<int>, Allocator,
+                         ChainedIndex<>, true, InlineStorage<8>>;
+    AllocationCounter tiny_counter;
+    size_t hashes = CountingHash<int>::calls;
+    {
+        Tiny tiny{Allocator(&tiny_counter)};
+        for (int i = 0; i < 8; i++) {
+            tiny[i] = 10 * i;
+        }
+        tiny.erase(3);
+        CHECK(!tiny.contains(3));
+        tiny.insert({3, 30});
+        Tiny copy(tiny);
+        Tiny moved(std::move(copy));
+        CHECK(moved.size() == 8 && moved.at(7) == 70 && tiny.bucket_count() == 0);
+    }
+    CHECK(tiny_counter.allocations == 0 && CountingHash<int>::calls == hashes);
+    Tiny tiny{Allocator(&tiny_counter)};
+    for (int i = 0; i < 9; i++) {
+        tiny[i] = i;
+    }
+    CHECK(tiny.bucket_count() > 0);
+    tiny.erase(8);
+    tiny.erase(7);
+    tiny.shrink_to_fit();
+    CHECK(tiny.bucket_count() == 0);
+    hashes = CountingHash<int>::calls;
+    for (int i = 0; i < 7; i++) {
+        CHECK(tiny.at(i) == i);
+    }
+    CHECK(CountingHash<int>::calls == hashes);
+
+    // Parallel build of few distinct keys keeps the linear mode, more keys leave it.
+    std::vector<std::pair<int, int>> pairs;
+    for (int i = 0; i < 40; i++) {
+        pairs.push_back({i % 8, i});
+    }
+    AllocationCounter built_counter;
+    {
+        Tiny built = Tiny::build_parallel(pairs.begin(), pairs.end(), ThreadExecutor(4),
+                                          CountingHash<int>(), std::equal_to<int>(),
+                                          Allocator(&built_counter));
+        CHECK(built.size() == 8 && built.bucket_count() == 0 && built.at(5) == 5);
+        CHECK(built_counter.allocations == 0);
+        built[8] = 8;
+        CHECK(built.bucket_count() > 0 && built.at(7) == 7 && built.at(8) == 8);
+    }
+    pairs.push_back({8, 40});
+    Tiny built = Tiny::build_parallel(pairs.begin(), pairs.end(), ThreadExecutor(4),
+                                      CountingHash<int>(), std::equal_to<int>(),
+                                      Allocator(&built_counter));
+    CHECK(built.size() == 9 && built.bucket_count() > 0 && built.at(8) == 40);
+}
+
+// Elements go back inline by copies, if their move may throw, a failed copy loses nothing.
+void test_shrink_exception_safety() {
+    Map<int, ThrowingCopy, ChainedIndex<>, false, InlineStorage<4>> map;
+    for (int i = 0; i < 5; i++) {
+        map.try_emplace(i, std::string(40, static_cast<char>('a' + i)));
+    }
+    map.erase(4);
+    ThrowingCopy::copies_left = 2;
+    CHECK_THROWS(std::runtime_error, map.shrink_to_fit());
+    ThrowingCopy::copies_left = -1;
+    for (int i = 0; i < 4; i++) {
+        CHECK(map.at(i).text == std::string(40, static_cast<char>('a' + i)));
+    }
+    map.shrink_to_fit();
+    CHECK(map.size() == 4 && map.bucket_count() == 0);
+    for (int i = 0; i < 4; i++) {
+        CHECK(map.at(i).text == std::string(40, static_cast<char>('a' + i)));
+    }
+}
+
+template<class M>
+void test_load_factors() {
+    M map;
+    for (int i = 0; i < 10000; i++) {
+        map[i] = i;
+    }
+    CHECK(map.load_factor() <= map.max_load_factor());
+    map.max_load_factor(0.25f);
+    CHECK(map.load_factor() <= 0.25f);
+    for (int i = 10000; i < 20000; i++) {
+        map[i] = i;
+    }
+    CHECK(map.load_factor() <= 0.25f);
+    size_t bucket_count = map.bucket_count();
+    map.clear_keep_capacity();
+    CHECK(map.size() == 0 && map.bucket_count() == bucket_count && !map.contains(5));
+    for (int i = 0; i < 1000; i++) {
+        map[i] = i;
+    }
+    CHECK(map.bucket_count() == bucket_count);
+    map.shrink_to_fit();
+    CHECK(map.bucket_count() < bucket_count);
+    for (int i = 0; i < 1000; i++) {
+        CHECK(map.at(i) == i);
+    }
+    map.max_load_factor(0.5f);
+    map.min_load_factor(0.9f);
+    CHECK(map.min_load_factor() <= 0.125f);
+    for (int i = 0; i < 50000; i++) {
+        map[i] = i;
+    }
+    size_t big = map.bucket_count();
+    for (int i = 0; i < 49000; i++) {
+        map.erase(i);
+    }
+    CHECK(map.bucket_count() < big / 8 && map.size() == 1000);
+    for (int i = 49000; i < 50000; i++) {
+        CHECK(map.at(i) == i);
+    }
+}
+
+/* Erase and insert at the highest load of GroupProbingIndex: every purge of deleted cells
+allocates once, and there must be a few of them, not one per insert. */
+void test_tombstone_purges() {
+    using Allocator = CountingAllocator<std::pair<const int, int>>;
+    AllocationCounter counter;
+    HashMap<int, int, WyHash<int>, std::equal_to<int>, Allocator, GroupProbingIndex<>> map{
+                    Allocator(&counter)};
+    map.max_load_factor(0.875f);
+    map.min_load_factor(0);
+    map.reserve(4000);
+    int next = 0;
+    while (map.size() + 1 < map.bucket_count() * map.max_load_factor()) {
+        map[next++] = 0;
+    }
+    size_t bucket_count = map.bucket_count();
+    size_t allocations = counter.allocations;
+    for (int i = 0; i < 20000; i++) {
+        map.erase(next - static_cast<int>(map.size()));
+        map[next++] = i;
+    }
+    CHECK(map.bucket_count() == bucket_count);
+    CHECK(counter.allocations - allocations < 20000 / 64);
+}
+
+template<class M>
+void test_iterators() {
+    M map;
+    for (int i = 0; i < 1000; i++) {
+        map[std::to_string(i)] = i;
+    }
+    auto position = map.begin();
+    position += 5;
+    CHECK(position - map.begin() == 5 && map.begin()[5].first == position->first);
+    typename M::const_iterator constant = position;
+    CHECK(constant == static_cast<const M&>(map).begin() + 5);
+    CHECK(std::distance(map.begin(), map.end()) == 1000);
+    auto found = std::find_if(map.begin(), map.end(),
+                              [](const auto& element) { return element.first == "77"; });
+    CHECK(found != map.end() && found->second == 77);
+    found->second = 1;
+    CHECK(map.at("77") == 1);
+    for (auto&& element : map) {
+        element.second++;
+    }
+    CHECK(map.at("77") == 2);
+    std::pair<std::string, int> copy = *map.begin();
+    CHECK(map.at(copy.first) == copy.second);
+    std::vector<std::pair<std::string, int>> elements(map.begin(), map.end());
+    CHECK(elements.size() == 1000);
+    using Traits = std::iterator_traits<typename M::iterator>;
+    static_assert(std::is_same<typename Traits::iterator_category, std::input_iterator_tag>::value,
+                  "");
+    static_assert(std::is_same<typename M::const_iterator::iterator_concept,
+                               std::random_access_iterator_tag>::value, "");
+    M from_iterators(map.begin(), map.end());
+    M reserved;
+    reserved.reserve(1000);
+    CHECK(from_iterators.size() == 1000);
+    CHECK(from_iterators.bucket_count() == reserved.bucket_count());
+    long sum = 0;
+    for (int value : map.values()) {
+        sum += value;
+    }
+    CHECK(sum == 999 * 500 + 1000 - 76);
+    std::sort(map.values().begin(), map.values().end());
+    CHECK(map.values().begin()[0] == 1);
+    size_t two_digit = 0;
+    for (const std::string& key : map.keys()) {
+        two_digit += (key.size() == 2);
+    }
+    CHECK(two_digit == 90);
+}
+
+template<class M>
+void test_batch_lookup() {
+    M map;
+    std::mt19937 random(1);
+    for (int i = 0; i < 20000; i++) {
+        map[random() % 40000] = i;
+    }
+    std::vector<int> keys(1003);
+    for (int& key : keys) {
+        key = random() % 40000;
+    }
+    std::vector<typename M::iterator> found(keys.size());
+    std::vector<typename M::const_iterator> constant(keys.size());
+    std::unique_ptr<bool[]> contained(new bool[keys.size()]);
+    map.find_batch(keys.data(), keys.size(), found.data());
+    static_cast<const M&>(map).find_batch(keys.data(), keys.size(), constant.data());
+    map.contains_batch(keys.data(), keys.size(), contained.get());
+    for (size_t i = 0; i < keys.size(); i++) {
+        CHECK(found[i] == map.find(keys[i]));
+        CHECK(constant[i] == static_cast<const M&>(map).find(keys[i]));
+        CHECK(contained[i] == map.contains(keys[i]));
+    }
+    map.contains_batch(keys.data(), 0, contained.get());
+}
+
+template<class M>
+void test_parallel(size_t count, int range) {
+    std::mt19937 random(5);
+    std::vector<std::pair<int, int>> pairs;
+    std::unordered_map<int, int> reference;
+    for (size_t i = 0; i < count; i++) {
+        int key = random() % range;
+        pairs.push_back({key, static_cast<int>(i)});
+        reference.insert({key, static_cast<int>(i)});
+    }
+    M map = M::build_parallel(pairs.begin(), pairs.end(), ThreadExecutor(4));
+    CHECK(map.size() == reference.size());
+    for (const auto& element : reference) {
+        CHECK(map.at(element.first) == element.second);
+    }
+    for (int i = 0; i < 100; i++) {
+        map.erase(i);
+    }
+    map.rehash_parallel(4 * map.size(), ThreadExecutor(3));
+    for (const auto& element : reference) {
+        CHECK(map.contains(element.first) == (element.first >= 100));
+    }
+}
+
+template<class A, class B>
+void test_moves_and_nodes() {
+    static_assert(std::is_nothrow_move_constructible<A>::value, "");
+    static_assert(std::is_nothrow_move_assignable<A>::value, "");
+    static_assert(std::is_nothrow_swappable<A>::value, "");
+    Counted::copies = 0;
+    A a;
+    for (int i = 0; i < 1000; i++) {
+        a.try_emplace(std::to_string(i), i);
+    }
+    A moved(std::move(a));
+    CHECK(a.size() == 0 && moved.size() == 1000 && moved.at("5").value == 5);
+    a["x"] = 1;
+    CHECK(a.size() == 1 && a.at("x").value == 1);
+    a = std::move(moved);
+    CHECK(a.size() == 1000 && moved.size() == 0);
+    std::vector<A> tables(1);
+    tables[0] = std::move(a);
+    for (int i = 0; i < 10; i++) {
+        tables.emplace_back();
+    }
+    a = std::move(tables[0]);
+    CHECK(a.size() == 1000 && Counted::copies == 0);
+
+    auto node = a.extract(std::string("7"));
+    CHECK(!node.empty() && node.key() == "7" && node.mapped().value == 7 && !a.contains("7"));
+    CHECK(a.extract(std::string("nope")).empty());
+    B b;
+    b.try_emplace("7", 70);
+    auto result = b.insert(std::move(node));
+    CHECK(!result.inserted && result.node && result.position->second.value == 70);
+    result.node.key() = "seven";
+    auto inserted = b.insert(std::move(result.node));
+    CHECK(inserted.inserted && inserted.node.empty() && b.at("seven").value == 7);
+    CHECK(!b.insert(typename B::node_type()).inserted);
+
+    // Merge leaves the duplicates in the source.
+    b.try_emplace("9", 90);
+    b.merge(a);
+    CHECK(a.size() == 1 && a.at("9").value == 9);
+    CHECK(b.size() == 1001 && b.at("9").value == 90 && b.at("100").value == 100);
+    A c;
+    A d;
+    for (int i = 0; i < 100; i++) {
+        d.try_emplace(std::to_string(i), i);
+    }
+    c.merge(std::move(d));
+    CHECK(c.size() == 100 && d.size() == 0 && c.at("42").value == 42);
+    swap(c, d);
+    CHECK(c.size() == 0 && d.size() == 100 && Counted::copies == 0);
+    A copy = d;
+    CHECK(copy.size() == 100 && Counted::copies == 100);
+}
+
+template<class A, class B>
+void test_set_operations() {
+    std::mt19937 random(3);
+    for (int iteration = 0; iteration < 50; iteration++) {
+        A a;
+        B b;
+        std::unordered_map<int, std::string> left;
+        std::unordered_map<int, std::string> right;
+        int left_count = random() % 300;
+        int right_count = (iteration % 5 == 0) ? random() % 5 : random() % 300;
+        for (int i = 0; i < left_count; i++) {
+            int key = random() % 400;
+            a[key] = left[key] = std::to_string(key);
+        }
+        for (int i = 0; i < right_count; i++) {
+            int key = random() % 400;
+            b[key] = right[key] = "b" + std::to_string(key);
+        }
+        size_t before = left.size();
+        switch (iteration % 5) {
+        case 0:
+            for (const auto& element : right) {
+                left.erase(element.first);
+            }
+            CHECK(a.difference(b) == before - left.size());
+            break;
+        case 1:
+            for (auto position = left.begin(); position != left.end();) {
+                position = right.count(position->first) ? std::next(position)
+                                                        : left.erase(position);
+            }
+            CHECK(a.intersect(b) == before - left.size());
+            break;
+        case 2:
+            for (const auto& element : right) {
+                left.emplace(element.first, element.second);
+            }
+            CHECK(a.union_with(b) == left.size() - before);
+            break;
+        case 3:
+            a.merge_with(b, [](std::string& value, const std::string& other) { value += other; });
+            for (const auto& element : right) {
+                left[element.first] += element.second;
+            }
+            CHECK(b.size() == right.size());
+            break;
+        default:
+            a.merge_with(std::move(b), [](std::string& value, std::string&& other) {
+                value += other;
+            });
+            for (const auto& element : right) {
+                left[element.first] += element.second;
+            }
+            CHECK(b.empty());
+            break;
+        }
+        CHECK(a.size() == left.size());
+        for (const auto& element : left) {
+            CHECK(a.at(element.first) == element.second);
+        }
+    }
+}
+
+// Hash with five values, so the perfect hash of freeze needs many levels.
+struct FiveHash {
+    size_t operator()(int key) const {
+        return static_cast<size_t>(key) % 5;
+    }
+};
+
+void test_freeze() {
+    for (size_t count : {0, 1, 2, 3, 64, 1000, 100000}) {
+        Map<uint64_t, uint64_t> map;
+        std::mt19937_64 random(count);
+        std::vector<uint64_t> keys;
+        for (size_t i = 0; i < count; i++) {
+            keys.push_back(random());
+            map[keys.back()] = keys.back() ^ 1;
+        }
+        const auto& constant = map;
+        auto frozen = constant.freeze();
+        CHECK(frozen.size() == map.size());
+        for (uint64_t key : keys) {
+            CHECK(frozen.find(key) && *frozen.find(key) == (key ^ 1));
+        }
+        for (int i = 0; i < 1000; i++) {
+            uint64_t key = random();
+            CHECK(frozen.contains(key) == map.contains(key));
+        }
+        auto moved = std::move(map).freeze();
+        CHECK(moved.size() == frozen.size());
+        for (uint64_t key : keys) {
+            CHECK(moved.at(key) == (key ^ 1));
+        }
+    }
+    Map<int, std::string, ChainedIndex<>, true, SplitStorage, FiveHash> colliding;
+    for (int i = 0; i < 100; i++) {
+        colliding[i] = std::to_string(i);
+    }
+    auto frozen = std::move(colliding).freeze();
+    for (int i = 0; i < 100; i++) {
+        CHECK(frozen.at(i) == std::to_string(i));
+    }
+    CHECK(!frozen.contains(100) && !frozen.contains(-3));
+    CHECK_THROWS(std::out_of_range, frozen.at(1000));
+}
+
+struct Point {
+    double x;
+    double y;
+};
+
+void test_snapshot() {
+    const char* path = "hash_map_test_snapshot.bin";
+    Map<uint64_t, Point, GroupProbingIndex<>, true, SplitStorage> map;
+    for (uint64_t i = 0; i < 100000; i++) {
+        map[i * 7919] = Point{static_cast<double>(i), -static_cast<double>(i)};
+    }
+    for (uint64_t i = 0; i < 1000; i++) {
+        map.erase(i * 7919 * 3);
+    }
+    map.save(path);
+    auto mapped = decltype(map)::open_mmap(path);
+    CHECK(mapped.size() == map.size());
+    for (uint64_t i = 0; i < 100000; i++) {
+        const Point* point = mapped.find(i * 7919);
+        CHECK((point != nullptr) == map.contains(i * 7919));
+        CHECK(point == nullptr || point->x == static_cast<double>(i));
+    }
+    CHECK(!mapped.contains(5) && mapped.at(7919).y == -1);
+    CHECK_THROWS(std::out_of_range, mapped.at(5));
+    auto moved = std::move(mapped);
+    CHECK(moved.size() == map.size() && moved.keys().size() == map.size());
+
+    Map<int, int> empty;
+    empty.save(path);
+    auto empty_mapped = Map<int, int>::open_mmap(path);
+    CHECK(empty_mapped.empty() && !empty_mapped.contains(1));
+    CHECK_THROWS(std::runtime_error, Map<int, long>::open_mmap(path));
+    CHECK_THROWS(std::runtime_error, Map<int, int>::open_mmap("/nonexistent/snapshot.bin"));
+    CHECK_THROWS(std::runtime_error, empty.save("/nonexistent/snapshot.bin"));
+    std::remove(path);
+}
+
+template<class IndexPolicy, bool CacheHash, class StoragePolicy>
+void test_stats() {
+    using M = HashMap<int, int, std::hash<int>, std::equal_to<int>,
+                      std::allocator<std::pair<const int, int>>, IndexPolicy, CacheHash,
+                      StoragePolicy, CountingStats>;
+    M map;
+    for (int i = 0; i < 10000; i++) {
+        map.insert({i, i});
+    }
+    auto inserted = map.stats();
+    CHECK(inserted.size == 10000 && inserted.rehashes > 0);
+    CHECK(inserted.lookups == 10000 && inserted.hits == 0);
+    map.reset_stats();
+    for (int i = 0; i < 20000; i++) {
+        map.contains(i);
+    }
+    auto stats = map.stats();
+    CHECK(stats.lookups == 20000 && stats.hits == 10000 && stats.misses() == 10000);
+    CHECK(stats.rehashes == 0 && stats.probes >= 10000);
+    uint64_t probes = 0;
+    for (uint64_t count : stats.probe_histogram) {
+        probes += count;
+    }
+    CHECK(probes == 20000);
+    CHECK(stats.chain_histogram.size() == map.max_chain_length() + 1);
+    CHECK(stats.allocated_bytes > 2 * 10000 * sizeof(int));
+    for (int i = 0; i < 10000; i += 2) {
+        map.erase(i);
+    }
+    CHECK(map.stats().lookups == 25000);
+    M copy = map;
+    CHECK(copy.stats().lookups == 25000);
+}
+
+void test_no_stats() {
+    Map<int, int> plain;
+    for (int i = 0; i < 100; i++) {
+        plain[i] = i;
+    }
+    auto stats = plain.stats();
+    CHECK(stats.size == 100 && stats.lookups == 0 && stats.rehashes == 0);
+    CHECK(stats.allocated_bytes > 0);
+    HashMap<int, int, std::hash<int>, std::equal_to<int>, std::allocator<std::pair<const int, int>>,
+            ChainedIndex<>, false, InlineStorage<8>, CountingStats> small;
+    for (int i = 0; i < 5; i++) {
+        small[i] = i;
+    }
+    small.find(4);
+    small.find(9);
+    auto small_stats = small.stats();
+    CHECK(small_stats.bucket_count == 0 && small_stats.allocated_bytes == 0);
+    CHECK(small_stats.lookups == 7 && small_stats.hits == 1);
+    CHECK(!small_stats.prometheus("small").empty());
+}
+
+}  // namespace
+
+int main() {
+    test_constructors<Map<int, int>>();
+    test_constructors<Map<int, int, GroupProbingIndex<PowerOfTwoSizing>, true>>();
+    test_constructors<Map<int, int, IncrementalChainedIndex<>>>();
+    test_constructors<Map<int, int, OpenAddressingIndex<PrimeSizing>>>();
+    test_insert_hashes_once();
+    test_aliasing_arguments<Map<int, std::string, ChainedIndex<>, false, InlineStorage<4>>>();
+    test_aliasing_arguments<Map<int, std::string, GroupProbingIndex<>, true, InlineStorage<4>>>();
+    test_aliasing_arguments<Map<int, std::string, OpenAddressingIndex<>, false, SplitStorage>>();
+    test_aliasing_arguments<Map<int, std::string>>();
+    test_transparent_lookup();
+    test_allocators();
+    test_shrink_exception_safety();
+    test_load_factors<Map<int, int>>();
+    test_load_factors<Map<int, int, IncrementalChainedIndex<>, true>>();
+    test_load_factors<Map<int, int, OpenAddressingIndex<PowerOfTwoSizing>, false, SplitStorage>>();
+    test_load_factors<Map<int, int, GroupProbingIndex<>, true>>();
+    test_tombstone_purges();
+    test_iterators<Map<std::string, int>>();
+    test_iterators<Map<std::string, int, OpenAddressingIndex<>, true, SplitStorage>>();
+    test_batch_lookup<Map<int, int>>();
+    test_batch_lookup<Map<int, int, IncrementalChainedIndex<>, true>>();
+    test_batch_lookup<Map<int, int, OpenAddressingIndex<>>>();
+    test_batch_lookup<Map<int, int, GroupProbingIndex<>, true>>();
+    test_parallel<Map<int, int>>(50000, 20000);
+    test_parallel<Map<int, int>>(10, 5);
+    test_parallel<Map<int, int>>(0, 5);
+    test_parallel<Map<int, int, IncrementalChainedIndex<PowerOfTwoSizing>, true>>(50000, 1 << 30);
+    test_parallel<Map<int, int, GroupProbingIndex<>>>(50000, 5000);
+    test_parallel<Map<int, int, OpenAddressingIndex<>, true, SplitStorage>>(50000, 20000);
+    test_moves_and_nodes<Map<std::string, Counted>,
+                         Map<std::string, Counted, OpenAddressingIndex<PowerOfTwoSizing>, true,
+                             SplitStorage>>();
+    test_moves_and_nodes<Map<std::string, Counted, IncrementalChainedIndex<>, true,
+                             InlineStorage<4>>,
+                         Map<std::string, Counted, GroupProbingIndex<>>>();
+    test_set_operations<Map<int, std::string>, Map<int, std::string>>();
+    test_set_operations<Map<int, std::string, OpenAddressingIndex<>, true>,
+                        Map<int, std::string, GroupProbingIndex<>, true>>();
+    test_set_operations<Map<int, std::string, GroupProbingIndex<>, true, SplitStorage,
+                            WyHash<int>>,
+                        Map<int, std::string, ChainedIndex<>, true, InlineStorage<8>,
+                            WyHash<int>>>();
+    test_freeze();
+    test_snapshot();
+    test_stats<ChainedIndex<>, false, PairStorage>();
+    test_stats<IncrementalChainedIndex<>, true, SplitStorage>();
+    test_stats<OpenAddressingIndex<PowerOfTwoSizing>, false, InlineStorage<4>>();
+    test_stats<GroupProbingIndex<>, true, PairStorage>();
+    test_no_stats();
+    return 0;
+}
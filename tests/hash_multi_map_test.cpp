@@ -0,0 +1,88 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#include <algorithm>
+#include <cstddef>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "hash_functions.h"
+#include "hash_multi_map.h"
+#include "tests/test_util.h"
+
+namespace {
+
+// Random inserts and erases compared with a std::map of vectors.
+template<class M>
+void test_against_map() {
+    M map;
+    std::map<int, std::vector<std::string>> reference;
+    std::mt19937 random(1);
+    auto predicate = [](const std::string& value) { return value.back() % 3 == 0; };
+    for (int step = 0; step < 50000; step++) {
+        int key = random() % 500;
+        int operation = random() % 10;
+        if (operation < 7) {
+            std::string value = std::to_string(random());
+            map.emplace(key, value);
+            reference[key].push_back(value);
+        } else if (operation == 7) {
+            CHECK(map.erase(key) == reference[key].size());
+            reference.erase(key);
+        } else if (operation == 8) {
+            auto& values = reference[key];
+            size_t before = values.size();
+            values.erase(std::remove_if(values.begin(), values.end(), predicate), values.end());
+            CHECK(map.erase_if(key, predicate) == before - values.size());
+            if (values.empty()) {
+                reference.erase(key);
+            }
+        } else if (step % 1000 == 9) {
+            map.shrink_to_fit();
+        }
+        if (step % 997 == 0) {
+            size_t total = 0;
+            for (const auto& element : reference) {
+                auto range = map.equal_range(element.first);
+                CHECK(std::vector<std::string>(range.begin(), range.end()) == element.second);
+                CHECK(map.count(element.first) == element.second.size());
+                total += element.second.size();
+            }
+            CHECK(map.size() == total && map.key_count() == reference.size());
+            size_t seen = 0;
+            map.for_each([&](int found, auto range) {
+                seen += range.size();
+                CHECK(reference.count(found) == 1);
+            });
+            CHECK(seen == total);
+        }
+    }
+    CHECK(map.count(100000) == 0 && map.equal_range(100000).size() == 0);
+    map.clear();
+    CHECK(map.empty());
+}
+
+void test_posting_lists() {
+    HashMultiMap<std::string, int> posting{{"a", 1}, {"b", 2}, {"a", 3}};
+    auto range = posting.equal_range("a");
+    CHECK(range.size() == 2 && range.begin()[0] == 1 && range.begin()[1] == 3);
+    const auto& constant = posting;
+    CHECK(constant.equal_range("b").size() == 1);
+    posting.insert({"c", 5});
+    posting.reserve(10, 100);
+    CHECK(posting.size() == 4 && posting.key_count() == 3 && posting.contains("c"));
+}
+
+}  // namespace
+
+int main() {
+    test_against_map<HashMultiMap<int, std::string>>();
+    test_against_map<HashMultiMap<int, std::string, WyHash<int>, std::equal_to<int>,
+                                  std::allocator<std::pair<const int, std::string>>,
+                                  GroupProbingIndex<>, true, SplitStorage>>();
+    test_posting_lists();
+    return 0;
+}
@@ -0,0 +1,54 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#include <cstdint>
+#include <functional>
+#include <utility>
+
+#include "hash_functions.h"
+#include "hash_map_2.h"
+#include "page_allocator.h"
+#include "tests/test_util.h"
+
+namespace {
+
+using Allocator = PageAllocator<std::pair<const uint64_t, uint64_t>>;
+using Table = HashMap<uint64_t, uint64_t, WyHash<uint64_t>, std::equal_to<uint64_t>, Allocator,
+                      GroupProbingIndex<>, true>;
+
+// Large blocks are mapped in every mode, the reserved modes fall back without the pool.
+void test_modes() {
+    for (HugePages mode : {HugePages::NONE, HugePages::TRANSPARENT, HugePages::RESERVED_2MB,
+                           HugePages::RESERVED_1GB}) {
+        Table table(WyHash<uint64_t>(), {}, Allocator(mode, 0));
+        for (uint64_t i = 0; i < 200000; i++) {
+            table[i] = i;
+        }
+        for (uint64_t i = 0; i < 200000; i += 7) {
+            CHECK(table.at(i) == i);
+        }
+        Table copy = table;
+        CHECK(copy.get_allocator() == Allocator(mode, 0) && copy.size() == table.size());
+        Table moved;
+        moved = std::move(copy);
+        CHECK(moved.get_allocator().node() == 0 && moved.get_allocator().huge_pages() == mode);
+        CHECK(moved.size() == table.size());
+    }
+}
+
+// Small blocks of the chained index come from operator new.
+void test_chained() {
+    HashMap<uint64_t, uint64_t, std::hash<uint64_t>, std::equal_to<uint64_t>, Allocator> table;
+    for (uint64_t i = 0; i < 100000; i++) {
+        table[i] = i;
+    }
+    table.erase(5);
+    CHECK(!table.contains(5) && table.size() == 99999);
+}
+
+}  // namespace
+
+int main() {
+    CHECK(numa_node_count() >= 1);
+    test_modes();
+    test_chained();
+    return 0;
+}
@@ -0,0 +1,79 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#include <atomic>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "read_mostly_hash_map.h"
+#include "tests/test_util.h"
+
+namespace {
+
+void test_readers_and_writer() {
+    ReadMostlyHashMap<int, std::string> map{{1, "one"}};
+    std::atomic<bool> stop{false};
+    std::atomic<long> hits{0};
+    std::vector<std::thread> readers;
+    for (int thread = 0; thread < 4; thread++) {
+        readers.emplace_back([&] {
+            while (!stop.load()) {
+                std::string value;
+                if (map.find(1, value)) {
+                    CHECK(value == "one");
+                    hits++;
+                }
+                map.read([](const auto& version) {
+                    size_t length = 0;
+                    for (auto&& element : version) {
+                        length += element.second.size();
+                    }
+                    return length;
+                });
+                map.contains(5);
+            }
+        });
+    }
+    for (int i = 0; i < 300; i++) {
+        map.insert({i + 2, std::to_string(i)});
+        if (i % 3 == 0) {
+            map.erase(i);
+        }
+    }
+    map.write([](auto& version) {
+        for (int i = 1000; i < 2000; i++) {
+            version[i] = "x";
+        }
+    });
+    stop = true;
+    for (auto& thread : readers) {
+        thread.join();
+    }
+    CHECK(map.at(1500) == "x" && map.contains(1));
+    map.insert_or_assign(1500, "y");
+    CHECK(map.at(1500) == "y");
+    map.clear();
+    CHECK(map.empty());
+}
+
+void test_policies() {
+    ReadMostlyHashMap<int, int, std::hash<int>, std::equal_to<int>,
+                      std::allocator<std::pair<const int, int>>, ChainedIndex<>, false,
+                      SplitStorage, CountingStats> map;
+    CHECK(map.stats().size == 0);
+    map.insert({1, 3});
+    CHECK(map.at(1) == 3 && map.stats().size == 1);
+    map.erase(1);
+    CHECK(map.empty());
+}
+
+}  // namespace
+
+int main() {
+    test_readers_and_writer();
+    test_policies();
+    return 0;
+}
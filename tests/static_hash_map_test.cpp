@@ -0,0 +1,42 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#include "static_hash_map.h"
+#include "tests/test_util.h"
+
+namespace {
+
+enum class Operation { GET, PUT, DELETE };
+
+constexpr auto OPERATIONS = make_static_hash_map<std::string_view, Operation>({
+                {"GET", Operation::GET}, {"PUT", Operation::PUT}, {"DELETE", Operation::DELETE}});
+static_assert(OPERATIONS.at("PUT") == Operation::PUT, "");
+static_assert(OPERATIONS.size() == 3 && OPERATIONS.contains("GET"), "");
+static_assert(!OPERATIONS.contains("POST"), "");
+static_assert(OPERATIONS.find("DELETE")->second == Operation::DELETE, "");
+
+constexpr auto NUMBERS = make_static_hash_map<int, int>({{1, 10}, {2, 20}, {-5, 7}, {1000000, 3}});
+static_assert(NUMBERS.at(-5) == 7 && NUMBERS.count(3) == 0, "");
+
+constexpr auto ONE = make_static_hash_map<Operation, const char*>({{Operation::GET, "get"}});
+static_assert(ONE.contains(Operation::GET) && !ONE.contains(Operation::PUT), "");
+
+}  // namespace
+
+int main(int argc, char**) {
+    // The key is not known at compile time.
+    std::string key = (argc > 5) ? "x" : "PUT";
+    CHECK(OPERATIONS.at(key) == Operation::PUT);
+    size_t length = 0;
+    for (const auto& element : OPERATIONS) {
+        length += element.first.size();
+    }
+    CHECK(length == 12);
+    CHECK_THROWS(std::out_of_range, OPERATIONS.at("nope"));
+    std::pair<int, int> duplicates[] = {{1, 1}, {1, 2}};
+    CHECK_THROWS(std::invalid_argument, make_static_hash_map<int, int>(duplicates));
+    return 0;
+}
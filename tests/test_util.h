@@ -0,0 +1,108 @@
+// "Copyright[2020] <ivanik01@yandex.ru>"
+#ifndef TESTS_TEST_UTIL_H_
+#define TESTS_TEST_UTIL_H_
+
+#include <cstddef>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <type_traits>
+
+// Checks the condition in every build type (assert is gone with NDEBUG) and aborts the test.
+#define CHECK(...)                                                                            \
+    do {                                                                                      \
+        if (!(__VA_ARGS__)) {                                                                 \
+            std::fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #__VA_ARGS__); \
+            std::abort();                                                                     \
+        }                                                                                     \
+    } while (0)
+
+// Checks that the statement throws the exception.
+#define CHECK_THROWS(Exception, ...)                                                          \
+    do {                                                                                      \
+        bool thrown = false;                                                                  \
+        try {                                                                                 \
+            __VA_ARGS__;                                                                      \
+        } catch (const Exception&) {                                                          \
+            thrown = true;                                                                    \
+        }                                                                                     \
+        CHECK(thrown);                                                                        \
+    } while (0)
+
+// Numbers of calls to allocate and deallocate of all CountingAllocator's that share it.
+struct AllocationCounter {
+    size_t allocations = 0;
+    size_t deallocations = 0;
+};
+
+// Counter of default constructed CountingAllocator's.
+inline AllocationCounter& default_allocation_counter() {
+    static AllocationCounter counter;
+    return counter;
+}
+
+/* Stateful allocator that counts allocations in its counter, copies and rebinds share the
+counter. It doesn't propagate on assignment, as custom allocators usually don't. */
+template<class T>
+class CountingAllocator {
+ public:
+    using value_type = T;
+
+    CountingAllocator() noexcept : counter_(&default_allocation_counter()) {}
+
+    explicit CountingAllocator(AllocationCounter* counter) noexcept : counter_(counter) {}
+
+    template<class U>
+    CountingAllocator(const CountingAllocator<U>& other) noexcept : counter_(other.counter()) {}
+
+    T* allocate(size_t count) {
+        counter_->allocations++;
+        return std::allocator<T>().allocate(count);
+    }
+
+    void deallocate(T* pointer, size_t count) noexcept {
+        counter_->deallocations++;
+        std::allocator<T>().deallocate(pointer, count);
+    }
+
+    AllocationCounter* counter() const noexcept {
+        return counter_;
+    }
+
+    template<class U>
+    bool operator==(const CountingAllocator<U>& other) const noexcept {
+        return counter_ == other.counter();
+    }
+
+    template<class U>
+    bool operator!=(const CountingAllocator<U>& other) const noexcept {
+        return counter_ != other.counter();
+    }
+
+ private:
+    AllocationCounter* counter_;
+};
+
+// Hash that counts its calls, to check how many times a key is hashed.
+template<class KeyType>
+struct CountingHash {
+    static inline size_t calls = 0;
+
+    size_t operator()(const KeyType& key) const {
+        calls++;
+        return std::hash<KeyType>()(key);
+    }
+};
+
+// Key of the number: the number itself or its string longer than the small string buffer.
+template<class KeyType>
+KeyType make_key(int number) {
+    if constexpr (std::is_same<KeyType, std::string>::value) {
+        return std::to_string(number) + std::string(20, 'k');
+    } else {
+        return static_cast<KeyType>(number);
+    }
+}
+
+#endif  // TESTS_TEST_UTIL_H_